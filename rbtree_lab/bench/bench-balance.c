@@ -0,0 +1,104 @@
+#include "rbtree.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-balance-<backend> [keys]
+// One binary per balancing backend (see the Makefile), all with -DRBTREE_STATS so the tree counts its
+// rotations. Every binary runs the same key streams; compare the rows across backends.
+
+#if defined(RBTREE_AVL)
+#define BACKEND "avl"
+#elif defined(RBTREE_WAVL)
+#define BACKEND "wavl"
+#elif defined(RBTREE_LLRB)
+#define BACKEND "llrb"
+#else
+#define BACKEND "rb"
+#endif
+
+static int height(const rbtree *t, const node_t *n)
+{
+  if (n == t->nil)
+  {
+    return 0;
+  }
+  const int l = height(t, n->left);
+  const int r = height(t, n->right);
+  return 1 + (l > r ? l : r);
+}
+
+static void report_rotations(const rbtree *t, const char *phase, const size_t ops, const double ns,
+                             const size_t rotations)
+{
+  printf("%-5s %-24s %10zu ops %8.1f ns/op %6.3f rot/op  height %d\n", BACKEND, phase, ops, ns / (double)ops,
+         (double)rotations / (double)ops, height(t, t->root));
+}
+
+// ascending keys: every insert lands on the right spine
+static void bench_ascending(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  const double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)i);
+  }
+  report_rotations(t, "insert (ascending)", n, now_ns() - start, t->rotations);
+  delete_rbtree(t);
+}
+
+// n random keys, then a fixed number of operations per read share: a read finds a key that is in
+// the tree, a write alternately erases the oldest key and inserts a new one, so the size stays at n
+static void bench_mixes(const size_t n)
+{
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  uint64_t lag = rng;
+  rbtree *t = new_rbtree();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)next_rand(&rng));
+  }
+  report_rotations(t, "insert (random)", n, now_ns() - start, t->rotations);
+
+  static const int read_pct[] = {0, 50, 90, 99};
+  uint64_t dice = 12345;
+  for (size_t m = 0; m < sizeof(read_pct) / sizeof(read_pct[0]); m++)
+  {
+    uint64_t probe = lag; // keys between lag and rng are in the tree
+    size_t hits = 0, writes = 0;
+    const size_t rotations = t->rotations;
+    start = now_ns();
+    for (size_t i = 0; i < n; i++)
+    {
+      if ((int)(next_rand(&dice) % 100) < read_pct[m])
+      {
+        hits += rbtree_find(t, (key_t)next_rand(&probe)) != NULL;
+      }
+      else if (writes++ % 2 == 0)
+      {
+        rbtree_erase(t, rbtree_find(t, (key_t)next_rand(&lag)));
+      }
+      else
+      {
+        rbtree_insert(t, (key_t)next_rand(&rng));
+      }
+    }
+    const double ns = now_ns() - start;
+    char phase[32];
+    snprintf(phase, sizeof(phase), "%d%% read / %d%% write", read_pct[m], 100 - read_pct[m]);
+    report_rotations(t, phase, n, ns, t->rotations - rotations);
+    (void)hits;
+  }
+  delete_rbtree(t);
+}
+
+int main(int argc, char *argv[])
+{
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  bench_ascending(n);
+  bench_mixes(n);
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "rbtree.h"
+#include "rbtree_btree.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-btree [ops]
+// Binary rbtree (one key per node) against the multiway rbtree_bt (dozens of keys per node) on the
+// same key stream: insert, find, to_array and erase.
+
+static int height(const rbtree *t, const node_t *n)
+{
+  if (n == t->nil)
+  {
+    return 0;
+  }
+  const int l = height(t, n->left);
+  const int r = height(t, n->right);
+  return 1 + (l > r ? l : r);
+}
+
+static void bench_binary(const size_t n, key_t *arr)
+{
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  const double base = rss_bytes();
+  rbtree *t = new_rbtree();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)next_rand(&rng));
+  }
+  report("binary", "insert", n, now_ns() - start);
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key, height %d\n", "binary", "memory", n,
+         (rss_bytes() - base) / (double)n, height(t, t->root));
+
+  uint64_t probe = 0x9e3779b97f4a7c15ULL;
+  size_t hits = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    hits += rbtree_find(t, (key_t)next_rand(&probe)) != NULL;
+  }
+  report("binary", "find (hit)", hits, now_ns() - start);
+
+  start = now_ns();
+  rbtree_to_array(t, arr, n);
+  report("binary", "to_array", n, now_ns() - start);
+
+  probe = 0x9e3779b97f4a7c15ULL;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_erase(t, rbtree_find(t, (key_t)next_rand(&probe)));
+  }
+  report("binary", "find+erase (drain)", n, now_ns() - start);
+  delete_rbtree(t);
+}
+
+static void bench_multiway(const size_t n, key_t *arr)
+{
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  const double base = rss_bytes();
+  rbtree_bt *t = new_rbtree_bt();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_bt_insert(t, (key_t)next_rand(&rng));
+  }
+  report("multiway", "insert", n, now_ns() - start);
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key, height %d\n", "multiway", "memory", n,
+         (rss_bytes() - base) / (double)n, t->height + 1);
+
+  uint64_t probe = 0x9e3779b97f4a7c15ULL;
+  size_t hits = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    hits += rbtree_bt_find(t, (key_t)next_rand(&probe)) != NULL;
+  }
+  report("multiway", "find (hit)", hits, now_ns() - start);
+
+  start = now_ns();
+  rbtree_bt_to_array(t, arr, n);
+  report("multiway", "to_array", n, now_ns() - start);
+
+  probe = 0x9e3779b97f4a7c15ULL;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_bt_erase(t, (key_t)next_rand(&probe));
+  }
+  report("multiway", "erase (drain)", n, now_ns() - start);
+  delete_rbtree_bt(t);
+}
+
+int main(int argc, char *argv[])
+{
+  const size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  key_t *arr = malloc(ops * sizeof(key_t));
+  bench_binary(ops, arr);
+  bench_multiway(ops, arr);
+  free(arr);
+  return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef _BENCH_COMMON_H_
+#define _BENCH_COMMON_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Helpers shared by the bench-*.c programs: key stream, clock, resident memory and the result line.
+
+// variant and phase columns of a result line; extra lines (memory, height) start with the same columns
+#define REPORT_COLUMNS "%-12s %-28s "
+
+// xorshift64: cheap enough not to show up next to the tree operations
+static inline uint64_t next_rand(uint64_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static inline double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// resident set size in bytes, from /proc (0 where it is not available)
+static inline double rss_bytes(void)
+{
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != NULL)
+  {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    fclose(f);
+  }
+  return (double)resident * (double)sysconf(_SC_PAGESIZE);
+}
+
+// one line per measured phase, so runs of different builds can be diffed
+static inline void report(const char *variant, const char *phase, const size_t ops, const double ns)
+{
+  printf(REPORT_COLUMNS "%12zu ops %10.1f ns/op\n", variant, phase, ops, ns / (double)ops);
+}
+
+#endif // _BENCH_COMMON_H_
@@ -0,0 +1,63 @@
+#include "rbtree.h"
+#include "rbtree_define.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-define [ops]
+// rbtree.c against the RBTREE_DEFINE instance for int keys on the same key stream. Same node layout
+// and algorithm; the generated code is inlined into this file and compares with `<` directly.
+
+RBTREE_DEFINE(rbtree_int, int, RBTREE_LESS)
+
+static uint64_t rng_state;
+
+#define BENCH_TREE(variant, tree, NEW, INSERT, FIND, ERASE, DELETE, MISSING) \
+  {                                                                          \
+    rng_state = 0x9e3779b97f4a7c15ULL;                                       \
+    tree *t = NEW();                                                         \
+    double start = now_ns();                                                 \
+    for (size_t i = 0; i < n; i++)                                           \
+      INSERT(t, (key_t)next_rand(&rng_state));                               \
+    report(variant, "insert", n, now_ns() - start);                          \
+                                                                             \
+    rng_state = 0x9e3779b97f4a7c15ULL;                                       \
+    size_t hits = 0;                                                         \
+    start = now_ns();                                                        \
+    for (size_t i = 0; i < n; i++)                                           \
+      hits += FIND(t, (key_t)next_rand(&rng_state)) != MISSING;              \
+    report(variant, "find (hit)", hits, now_ns() - start);                   \
+                                                                             \
+    start = now_ns();                                                        \
+    for (size_t i = 0; i < n; i++)                                           \
+    {                                                                        \
+      ERASE(t, t->root);                                                     \
+      INSERT(t, (key_t)next_rand(&rng_state));                               \
+    }                                                                        \
+    report(variant, "erase root+insert", n, now_ns() - start);               \
+                                                                             \
+    rng_state = 0x9e3779b97f4a7c15ULL;                                       \
+    start = now_ns();                                                        \
+    for (size_t i = 0; i < n; i++)                                           \
+      ERASE(t, FIND(t, (key_t)next_rand(&rng_state)));                       \
+    report(variant, "find+erase", n, now_ns() - start);                      \
+    DELETE(t);                                                               \
+  }
+
+// the same phases for both trees, so the only difference is the code behind the calls
+static void bench_rbtree(const size_t n)
+BENCH_TREE("rbtree.c", rbtree, new_rbtree, rbtree_insert, rbtree_find, rbtree_erase, delete_rbtree, NULL)
+
+static void bench_define(const size_t n)
+BENCH_TREE("define", rbtree_int, new_rbtree_int, rbtree_int_insert, rbtree_int_find, rbtree_int_erase, delete_rbtree_int, NULL)
+
+int main(int argc, char *argv[])
+{
+  const size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  bench_rbtree(ops);
+  bench_define(ops);
+  bench_rbtree(ops);
+  bench_define(ops);
+  return 0;
+}
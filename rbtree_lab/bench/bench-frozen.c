@@ -0,0 +1,77 @@
+#include "rbtree.h"
+#include "rbtree_frozen.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-frozen [keys] [queries]
+// Build a tree once, freeze it, then run the same query stream through rbtree_find / rbtree_lower_bound
+// and through the Eytzinger snapshot. bench-frozen-avx2 is the same source built with -mavx2.
+
+#ifdef __AVX2__
+#define VARIANT "frozen-avx2"
+#else
+#define VARIANT "frozen"
+#endif
+
+int main(int argc, char *argv[])
+{
+  const size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  const size_t queries = argc > 2 ? strtoull(argv[2], NULL, 10) : 10000000;
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)(next_rand(&rng) % (4 * n)));
+  }
+
+  double start = now_ns();
+  rbtree_frozen *f = rbtree_freeze(t);
+  report(VARIANT, "freeze", n, now_ns() - start);
+
+  // keys drawn from 4n values: about a quarter of the finds hit
+  uint64_t probe = 12345;
+  size_t found = 0;
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++)
+  {
+    found += rbtree_find(t, (key_t)(next_rand(&probe) % (4 * n))) != NULL;
+  }
+  report("tree", "find", queries, now_ns() - start);
+
+  probe = 12345;
+  size_t frozen_found = 0;
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++)
+  {
+    frozen_found += rbtree_frozen_find(f, (key_t)(next_rand(&probe) % (4 * n))) != NULL;
+  }
+  report(VARIANT, "find", queries, now_ns() - start);
+
+  probe = 12345;
+  uintptr_t sink = 0;
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++)
+  {
+    sink ^= (uintptr_t)rbtree_lower_bound(t, (key_t)(next_rand(&probe) % (4 * n)));
+  }
+  report("tree", "lower_bound", queries, now_ns() - start);
+
+  probe = 12345;
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++)
+  {
+    sink ^= (uintptr_t)rbtree_frozen_lower_bound(f, (key_t)(next_rand(&probe) % (4 * n)));
+  }
+  report(VARIANT, "lower_bound", queries, now_ns() - start);
+
+  if (found != frozen_found || sink != 0)
+  {
+    printf("mismatch: %zu vs %zu hits\n", found, frozen_found);
+    return 1;
+  }
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "rbtree.h"
+#include "rbtree_index.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-index [ops]
+// Pointer-linked rbtree against the uint32_t index-linked rbtree_idx on the same key stream.
+
+static uint64_t rng_state;
+
+static void bench_pointer(const size_t n)
+{
+  rng_state = 0x9e3779b97f4a7c15ULL;
+  const double base = rss_bytes();
+  rbtree *t = new_rbtree();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)next_rand(&rng_state));
+  }
+  report("pointer", "insert", n, now_ns() - start);
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key (node %zu B)\n", "pointer", "memory", n,
+         (rss_bytes() - base) / (double)n, sizeof(node_t));
+
+  rng_state = 0x9e3779b97f4a7c15ULL;
+  size_t hits = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    hits += rbtree_find(t, (key_t)next_rand(&rng_state)) != NULL;
+  }
+  report("pointer", "find (hit)", hits, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_erase(t, t->root);
+    rbtree_insert(t, (key_t)next_rand(&rng_state));
+  }
+  report("pointer", "erase root+insert", n, now_ns() - start);
+  delete_rbtree(t);
+}
+
+static void bench_index(const size_t n)
+{
+  rng_state = 0x9e3779b97f4a7c15ULL;
+  const double base = rss_bytes();
+  rbtree_idx *t = new_rbtree_idx();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_idx_insert(t, (key_t)next_rand(&rng_state));
+  }
+  report("index", "insert", n, now_ns() - start);
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key (node %zu B)\n", "index", "memory", n,
+         (rss_bytes() - base) / (double)n, sizeof(inode_t));
+
+  rng_state = 0x9e3779b97f4a7c15ULL;
+  size_t hits = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    hits += rbtree_idx_find(t, (key_t)next_rand(&rng_state)) != RBIDX_NIL;
+  }
+  report("index", "find (hit)", hits, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_idx_erase(t, t->root);
+    rbtree_idx_insert(t, (key_t)next_rand(&rng_state));
+  }
+  report("index", "erase root+insert", n, now_ns() - start);
+  delete_rbtree_idx(t);
+}
+
+int main(int argc, char *argv[])
+{
+  const size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  bench_pointer(ops);
+  bench_index(ops);
+  return 0;
+}
@@ -0,0 +1,361 @@
+#include "rbtree.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+// usage: ./bench-rbtree [ops]
+// Prints one line per measured phase so runs of different builds can be diffed.
+
+#if defined(RBTREE_AUGMENT)
+#define VARIANT "augment"
+#elif defined(RBTREE_ORDER_STAT)
+#define VARIANT "orderstat"
+#elif defined(RBTREE_CALLOC_NODES)
+#define VARIANT "calloc"
+#elif defined(RBTREE_COUNTED)
+#define VARIANT "counted"
+#elif defined(RBTREE_MAP)
+#define VARIANT "map"
+#elif defined(RBTREE_COMPACT)
+#define VARIANT "compact"
+#else
+#define VARIANT "slab"
+#endif
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+// resident memory per key of a tree of n random keys; runs first so the peak RSS is the tree's
+static void bench_memory(const size_t n)
+{
+  struct rusage before, after;
+  getrusage(RUSAGE_SELF, &before);
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)next_rand(&rng_state));
+  }
+  getrusage(RUSAGE_SELF, &after);
+  const double bytes = (double)(after.ru_maxrss - before.ru_maxrss) * 1024.0; // ru_maxrss is in KiB on Linux
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key (sizeof(node_t) %zu)\n", VARIANT, "memory", n, bytes / (double)n,
+         sizeof(node_t));
+  delete_rbtree(t);
+}
+
+// insert/erase churn on a tree holding ops/10 keys
+static void bench_churn(const size_t ops)
+{
+  const size_t live = ops / 10 > 0 ? ops / 10 : 1;
+  node_t **held = malloc(live * sizeof(node_t *));
+  rbtree *t = new_rbtree();
+
+  double start = now_ns();
+  for (size_t i = 0; i < live; i++)
+  {
+    held[i] = rbtree_insert(t, (key_t)next_rand(&rng_state));
+  }
+  report(VARIANT, "insert", live, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    const size_t j = next_rand(&rng_state) % live;
+    rbtree_erase(t, held[j]);
+    held[j] = rbtree_insert(t, (key_t)next_rand(&rng_state));
+  }
+  report(VARIANT, "erase+insert", ops, now_ns() - start);
+
+  start = now_ns();
+  delete_rbtree(t);
+  report(VARIANT, "delete_rbtree", live, now_ns() - start);
+
+  free(held);
+}
+
+#ifndef RBTREE_CALLOC_NODES
+// bench_churn with caller-owned nodes: the objects already exist, so the tree never allocates
+static void bench_intrusive(const size_t ops)
+{
+  typedef struct
+  {
+    long payload;
+    node_t link;
+  } object;
+  const size_t live = ops / 10 > 0 ? ops / 10 : 1;
+  object *objs = malloc(live * sizeof(object));
+  rbtree *t = new_rbtree();
+
+  double start = now_ns();
+  for (size_t i = 0; i < live; i++)
+  {
+    objs[i].link.key = (key_t)next_rand(&rng_state);
+    rbtree_insert_node(t, &objs[i].link);
+  }
+  report(VARIANT, "insert_node", live, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    object *o = &objs[next_rand(&rng_state) % live];
+    rbtree_remove_node(t, &o->link);
+    o->link.key = (key_t)next_rand(&rng_state);
+    rbtree_insert_node(t, &o->link);
+  }
+  report(VARIANT, "remove_node+insert_node", ops, now_ns() - start);
+
+  delete_rbtree(t); // slab builds leave the linked objects alone
+  free(objs);
+}
+#endif
+
+// ops keys arrive in batches: rbtree_insert in a loop vs rbtree_insert_batch
+static void bench_batch(const size_t ops, const size_t batch)
+{
+  key_t *keys = malloc(batch * sizeof(key_t));
+  char phase[64];
+
+  for (int batched = 0; batched < 2; batched++)
+  {
+    rbtree *t = new_rbtree();
+    double ns = 0;
+    for (size_t done = 0; done < ops; done += batch)
+    {
+      const size_t m = ops - done < batch ? ops - done : batch;
+      for (size_t i = 0; i < m; i++)
+      {
+        keys[i] = (key_t)next_rand(&rng_state);
+      }
+      const double start = now_ns();
+      if (batched)
+      {
+        rbtree_insert_batch(t, keys, m);
+      }
+      else
+      {
+        for (size_t i = 0; i < m; i++)
+        {
+          rbtree_insert(t, keys[i]);
+        }
+      }
+      ns += now_ns() - start;
+    }
+    snprintf(phase, sizeof(phase), "%s (batch %zu)", batched ? "insert_batch" : "insert loop", batch);
+    report(VARIANT, phase, ops, ns);
+    delete_rbtree(t);
+  }
+  free(keys);
+}
+
+// timestamps-like stream: ascending with 1 in 16 keys arriving a little late
+static void bench_ascending(const size_t ops)
+{
+  rbtree *t = new_rbtree();
+  double start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    const key_t late = next_rand(&rng_state) % 16 == 0 ? (key_t)(next_rand(&rng_state) % 64) : 0;
+    rbtree_insert(t, (key_t)i - late);
+  }
+  report(VARIANT, "insert ascending", ops, now_ns() - start);
+  delete_rbtree(t);
+
+  t = new_rbtree();
+  node_t *hint = NULL;
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) // descending, passing the previous node as the hint
+  {
+    hint = rbtree_insert_hint(t, (key_t)(ops - i), hint);
+  }
+  report(VARIANT, "insert_hint descending", ops, now_ns() - start);
+  delete_rbtree(t);
+}
+
+// binary min-heap on a plain array: the baseline a scheduler would otherwise use
+static void heap_push(key_t *h, size_t *n, const key_t key)
+{
+  size_t i = (*n)++;
+  while (i > 0 && h[(i - 1) / 2] > key)
+  {
+    h[i] = h[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h[i] = key;
+}
+
+static key_t heap_pop(key_t *h, size_t *n)
+{
+  const key_t top = h[0];
+  const key_t last = h[--(*n)];
+  size_t i = 0;
+  for (size_t c = 1; c < *n; c = 2 * i + 1)
+  {
+    if (c + 1 < *n && h[c + 1] < h[c])
+    {
+      c++;
+    }
+    if (last <= h[c])
+    {
+      break;
+    }
+    h[i] = h[c];
+    i = c;
+  }
+  h[i] = last;
+  return top;
+}
+
+// hold model of an event scheduler with ops/10 pending events: pop the earliest, push it back later
+static void bench_scheduler(const size_t ops)
+{
+  const size_t live = ops / 10 > 0 ? ops / 10 : 1;
+  rbtree *t = new_rbtree();
+  key_t *heap = malloc(live * sizeof(key_t));
+  size_t n = 0;
+  for (size_t i = 0; i < live; i++)
+  {
+    const key_t due = (key_t)(next_rand(&rng_state) % (4 * live));
+    rbtree_insert(t, due);
+    heap_push(heap, &n, due);
+  }
+
+  const uint64_t seed = rng_state;
+  key_t sink = 0;
+  double start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    key_t now;
+    rbtree_pop_min(t, &now);
+    rbtree_insert(t, now + (key_t)(next_rand(&rng_state) % (4 * live)));
+    sink += now;
+  }
+  report(VARIANT, "pop_min+insert", ops, now_ns() - start);
+
+  rng_state = seed; // same delays for the heap
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    const key_t now = heap_pop(heap, &n);
+    heap_push(heap, &n, now + (key_t)(next_rand(&rng_state) % (4 * live)));
+    sink -= now;
+  }
+  report(VARIANT, "binary heap pop+push", ops, now_ns() - start);
+  if (sink != 0) // both queues must have produced the same schedule
+  {
+    printf("scheduler mismatch\n");
+  }
+
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    sink += rbtree_min(t)->key + rbtree_max(t)->key;
+  }
+  report(VARIANT, "min+max", ops, now_ns() - start);
+  free(heap);
+  delete_rbtree(t);
+}
+
+// ops keys drawn from ops/10000 values, so every key repeats ~10^4 times: insert, export, then drain
+static void bench_duplicates(const size_t ops)
+{
+  const uint64_t values = ops / 10000 > 0 ? ops / 10000 : 1;
+  key_t *out = malloc(ops * sizeof(key_t));
+  rbtree *t = new_rbtree();
+
+  double start = now_ns();
+  for (size_t i = 0; i < ops; i++)
+  {
+    rbtree_insert(t, (key_t)(next_rand(&rng_state) % values));
+  }
+  report(VARIANT, "insert (10^4 dups/key)", ops, now_ns() - start);
+
+  start = now_ns();
+  rbtree_to_array(t, out, ops);
+  report(VARIANT, "to_array (10^4 dups/key)", ops, now_ns() - start);
+
+  start = now_ns();
+  while (t->count > 0)
+  {
+    rbtree_erase(t, rbtree_min(t));
+  }
+  report(VARIANT, "erase min (10^4 dups/key)", ops, now_ns() - start);
+
+  delete_rbtree(t);
+  free(out);
+}
+
+// full ordered scan of a tree built from random keys: cursor vs rbtree_to_array
+static void bench_scan(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t *out = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)next_rand(&rng_state));
+  }
+
+  double start = now_ns();
+  rbtree_to_array(t, out, n);
+  report(VARIANT, "scan rbtree_to_array", n, now_ns() - start);
+
+  start = now_ns();
+  size_t i = 0;
+  for (node_t *p = rbtree_lower_bound(t, out[0]); p != NULL; p = rbtree_next(t, p))
+  {
+    out[i++] = p->key;
+  }
+  report(VARIANT, "scan lower_bound+next", i, now_ns() - start);
+
+  delete_rbtree(t);
+  free(out);
+}
+
+#ifdef RBTREE_MAP
+// ops updates of keys drawn from ops values (most are new): find-then-insert walks twice for a new key, rbtree_upsert once
+static void bench_upsert(const size_t ops)
+{
+  const uint64_t range = ops > 0 ? ops : 1;
+  for (int single = 0; single < 2; single++)
+  {
+    rbtree *t = new_rbtree();
+    const double start = now_ns();
+    for (size_t i = 0; i < ops; i++)
+    {
+      const key_t key = (key_t)(next_rand(&rng_state) % range);
+      if (single)
+      {
+        rbtree_upsert(t, key, (value_t)i);
+        continue;
+      }
+      node_t *p = rbtree_find(t, key);
+      if (p == NULL)
+      {
+        p = rbtree_insert(t, key);
+      }
+      p->value = (value_t)i;
+    }
+    report(VARIANT, single ? "upsert" : "find+insert", ops, now_ns() - start);
+    delete_rbtree(t);
+  }
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+  const size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  bench_memory(ops);
+  bench_churn(ops);
+#ifndef RBTREE_CALLOC_NODES // delete_rbtree would free() the linked objects
+  bench_intrusive(ops);
+#endif
+  bench_batch(ops, 10000);
+  bench_batch(ops, 100000);
+  bench_scan(ops);
+  bench_ascending(ops);
+  bench_scheduler(ops);
+  bench_duplicates(ops);
+#ifdef RBTREE_MAP
+  bench_upsert(ops);
+#endif
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include "rbtree_sync.h"
+#include "rbtree_shard.h"
+#include "bench-common.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-sync [ops] [max_threads]
+// Scaling of the thread-safe containers: the same total op count is split over 1, 2, 4, ... threads.
+
+#ifdef BENCH_SHARD
+// key-range sharded container, one part per expected core
+#define SHARD_PARTS 16
+typedef rbtree_shard container;
+#define container_new(range) new_rbtree_shard(SHARD_PARTS, 0, (range))
+#define container_delete delete_rbtree_shard
+#define container_insert rbtree_shard_insert
+#define container_erase rbtree_shard_erase
+#define container_find rbtree_shard_find
+#else
+typedef rbtree_sync container;
+#define container_new(range) new_rbtree_sync()
+#define container_delete delete_rbtree_sync
+#define container_insert rbtree_sync_insert
+#define container_erase rbtree_sync_erase
+#define container_find rbtree_sync_find
+#endif
+
+#if defined(BENCH_SHARD)
+#define VARIANT "shard"
+#elif defined(RBTREE_SYNC_MUTEX)
+#define VARIANT "mutex"
+#elif defined(RBTREE_SYNC_NO_OPTIMISTIC)
+#define VARIANT "rwlock"
+#else
+#define VARIANT "seqlock"
+#endif
+
+typedef struct
+{
+  container *s;
+  size_t ops;
+  int write_pct;
+  uint64_t seed;
+  key_t key_range;
+} worker_arg;
+
+static void *worker(void *p)
+{
+  worker_arg *a = p;
+  for (size_t i = 0; i < a->ops; i++)
+  {
+    const uint64_t r = next_rand(&a->seed);
+    const key_t key = (key_t)(r % (uint64_t)a->key_range);
+    if ((int)(r >> 40) % 100 < a->write_pct)
+    {
+      // keep the size stable: every insert is paired with an erase of a random key
+      if (r & (1ULL << 32))
+        container_insert(a->s, key);
+      else
+        container_erase(a->s, key);
+    }
+    else
+    {
+      container_find(a->s, key);
+    }
+  }
+  return NULL;
+}
+
+static void bench_scaling(const size_t ops, const int max_threads, const int write_pct)
+{
+  const key_t key_range = (key_t)(ops / 5 > 1000 ? ops / 5 : 1000);
+  container *s = container_new(key_range);
+  for (key_t k = 0; k < key_range; k += 2)
+  {
+    container_insert(s, k);
+  }
+
+  pthread_t *threads = malloc(max_threads * sizeof(pthread_t));
+  worker_arg *args = malloc(max_threads * sizeof(worker_arg));
+  for (int n = 1; n <= max_threads; n *= 2)
+  {
+    const double start = now_ns();
+    for (int i = 0; i < n; i++)
+    {
+      args[i] = (worker_arg){s, ops / n, write_pct, 0x9e3779b97f4a7c15ULL * (i + 1), key_range};
+      pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    for (int i = 0; i < n; i++)
+    {
+      pthread_join(threads[i], NULL);
+    }
+    const double ns = now_ns() - start;
+    printf("%-8s reads %3d%%  threads %3d %12zu ops %10.2f Mops/s\n", VARIANT, 100 - write_pct, n,
+           ops / n * n, (double)(ops / n * n) / ns * 1e3);
+  }
+
+  free(args);
+  free(threads);
+  container_delete(s);
+}
+
+int main(int argc, char *argv[])
+{
+  const size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  const int max_threads = argc > 2 ? atoi(argv[2]) : 64;
+  bench_scaling(ops, max_threads, 0);
+  bench_scaling(ops, max_threads, 5);
+  bench_scaling(ops, max_threads, 50);
+  return 0;
+}
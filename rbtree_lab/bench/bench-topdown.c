@@ -0,0 +1,101 @@
+#include "rbtree.h"
+#include "rbtree_topdown.h"
+#include "bench-common.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// usage: ./bench-topdown [ops]
+// Bottom-up rbtree (parent pointers, fix-up climbs back) against the single-pass top-down rbtree_td
+// on the same key stream.
+
+// the erase stream replays the insert stream from the start, so every erased key is present
+static void bench_bottomup(const size_t n)
+{
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  uint64_t lag = rng;
+  const double base = rss_bytes();
+  rbtree *t = new_rbtree();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, (key_t)next_rand(&rng));
+  }
+  report("bottom-up", "insert", n, now_ns() - start);
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key (node %zu B)\n", "bottom-up", "memory", n,
+         (rss_bytes() - base) / (double)n, sizeof(node_t));
+
+  uint64_t probe = 0x9e3779b97f4a7c15ULL;
+  size_t hits = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    hits += rbtree_find(t, (key_t)next_rand(&probe)) != NULL;
+  }
+  report("bottom-up", "find (hit)", hits, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_erase(t, rbtree_find(t, (key_t)next_rand(&lag)));
+    rbtree_insert(t, (key_t)next_rand(&rng));
+  }
+  report("bottom-up", "find+erase+insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_erase(t, rbtree_find(t, (key_t)next_rand(&lag)));
+  }
+  report("bottom-up", "find+erase (drain)", n, now_ns() - start);
+  delete_rbtree(t);
+}
+
+static void bench_topdown(const size_t n)
+{
+  uint64_t rng = 0x9e3779b97f4a7c15ULL;
+  uint64_t lag = rng;
+  const double base = rss_bytes();
+  rbtree_td *t = new_rbtree_td();
+  double start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_td_insert(t, (key_t)next_rand(&rng));
+  }
+  report("top-down", "insert", n, now_ns() - start);
+  printf(REPORT_COLUMNS "%12zu keys %8.1f B/key (node %zu B)\n", "top-down", "memory", n,
+         (rss_bytes() - base) / (double)n, sizeof(tdnode_t));
+
+  uint64_t probe = 0x9e3779b97f4a7c15ULL;
+  size_t hits = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    hits += rbtree_td_find(t, (key_t)next_rand(&probe)) != NULL;
+  }
+  report("top-down", "find (hit)", hits, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_td_erase(t, (key_t)next_rand(&lag));
+    rbtree_td_insert(t, (key_t)next_rand(&rng));
+  }
+  report("top-down", "erase+insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_td_erase(t, (key_t)next_rand(&lag));
+  }
+  report("top-down", "erase (drain)", n, now_ns() - start);
+  delete_rbtree_td(t);
+}
+
+int main(int argc, char *argv[])
+{
+  const size_t ops = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+  bench_bottomup(ops);
+  bench_topdown(ops);
+  return 0;
+}
@@ -1,22 +1,113 @@
 #include "rbtree.h"
+#include "rbtree_slab.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifndef RBTREE_CHUNK_NODES
+#define RBTREE_CHUNK_NODES 1024 // nodes in the first slab chunk when no capacity is requested
+#endif
+
+#ifndef RBTREE_CHUNK_NODES_MAX
+#define RBTREE_CHUNK_NODES_MAX (1u << 22) // chunks double up to this many nodes (~128MB of 32-byte nodes)
+#endif
+
+#ifdef RBTREE_INTERVAL
+#define NO_END INT_MIN // max_end of a subtree holding only empty intervals: ends after no lo
+#endif
+
+// What each balancing backend (see rbtree.h) keeps per node; everything else in this file is shared.
+#ifdef RBTREE_RANKED
+#define mark_sentinel(n) ((n)->rank = -1)                                                              // missing children have rank -1
+#define mark_leaf(n) ((n)->rank = 0)                                                                   // a new leaf has rank 0
+#define copy_balance(dst, src) ((dst)->rank = (src)->rank)                                             // successor takes over the rank
+#define removal_unbalances(n) 1                                                                        // any removal may shorten the path
+#define taller_child_rank(n) ((n)->left->rank > (n)->right->rank ? (n)->left->rank : (n)->right->rank) // rank of the higher child
+#define set_sorted_balance(n, depth, red_depth) ((n)->rank = 1 + taller_child_rank(n))                 // height, from both halves
+#else
+#define mark_sentinel(n) rbtree_set_color((n), RBTREE_BLACK)                                                              // sentinel is black
+#define mark_leaf(n) rbtree_set_color((n), RBTREE_RED)                                                                    // new nodes are red
+#define copy_balance(dst, src) rbtree_set_color((dst), rbtree_color(src))                                                 // successor takes over the color
+#define removal_unbalances(n) (rbtree_color(n) == RBTREE_BLACK)                                                           // only black nodes count on paths
+#define set_sorted_balance(n, depth, red_depth) rbtree_set_color((n), (depth) == (red_depth) ? RBTREE_RED : RBTREE_BLACK) // color from depth
+#endif
+#if !defined(RBTREE_RANKED) && !defined(RBTREE_LLRB)
+#define RBTREE_CLRS // the default backend
+#endif
+
+/* Purpose: Zeroed storage aligned for node_t; calloc only promises 16 bytes, short of the compact layout's 32. */
+static void *node_zalloc(const size_t size)
+{
+#ifdef RBTREE_COMPACT
+  const size_t rounded = (size + _Alignof(node_t) - 1) & ~(_Alignof(node_t) - 1); // aligned_alloc wants a multiple
+  void *p = aligned_alloc(_Alignof(node_t), rounded);                              // node-aligned block
+  if (p != NULL)                                                                   // out of memory otherwise
+    memset(p, 0, rounded);                                                         // same contents calloc gives
+  return p;                                                                        // NULL on failure
+#else
+  return calloc(1, size); // node_t needs no more than malloc's alignment
+#endif
+}
+
+#ifndef RBTREE_CALLOC_NODES
+// node_t as the slab sees it: free nodes are linked through ->right, so an optimistic reader that
+// lands on one still follows a pointer into the slab (see rbtree_sync.c)
+static const rbtree_slab_kind node_kind = {sizeof(node_t), _Alignof(node_t), offsetof(node_t, right), RBTREE_CHUNK_NODES,
+                                           RBTREE_CHUNK_NODES_MAX};
+#endif
+
+/* Purpose: Get storage for one node from the tree's slab, or from malloc in RBTREE_CALLOC_NODES builds. */
+static node_t *node_alloc(rbtree *t)
+{
+#ifdef RBTREE_CALLOC_NODES
+  (void)t;                                      // plain heap allocation ignores the tree
+  return (node_t *)node_zalloc(sizeof(node_t)); // one malloc per node
+#else
+  return (node_t *)slab_alloc(&t->slab, &node_kind); // recycled node first, then the current chunk, then a new chunk
+#endif
+}
+
+/* Purpose: Give a node back to the tree's free list, or to malloc in RBTREE_CALLOC_NODES builds. */
+static void node_free(rbtree *t, node_t *n)
+{
+#ifdef RBTREE_CALLOC_NODES
+  (void)t;  // plain heap allocation ignores the tree
+  free(n);  // return to malloc
+#else
+  slab_free(&t->slab, &node_kind, n); // push on free list for the next insert
+#endif
+}
 
 /* Purpose: Create and initialize a new empty red-black tree. */
 rbtree *new_rbtree(void)
 {
-  rbtree *t = (rbtree *)calloc(1, sizeof(rbtree));   // allocate tree struct
-  node_t *nil = (node_t *)calloc(1, sizeof(node_t)); // allocate sentinel node
-  nil->color = RBTREE_BLACK;                         // sentinel is black
-  nil->parent = nil;                                 // sentinel parent points to itself
-  nil->left = nil;                                   // sentinel left points to itself
-  nil->right = nil;                                  // sentinel right points to itself
-  t->nil = nil;                                      // attach sentinel to tree
-  t->root = t->nil;                                  // empty tree: root == nil
-  return t;                                          // return initialized tree
+  return new_rbtree_with_capacity(0); // slab grows on demand
+}
+
+/* Purpose: Create an empty tree whose slab already holds room for `capacity` nodes. */
+rbtree *new_rbtree_with_capacity(const size_t capacity)
+{
+  rbtree *t = (rbtree *)calloc(1, sizeof(rbtree));     // allocate tree struct
+  node_t *nil = (node_t *)node_zalloc(sizeof(node_t)); // allocate sentinel node
+  mark_sentinel(nil);                                  // black, or rank -1
+  rbtree_set_parent(nil, nil);                         // sentinel parent points to itself
+  nil->left = nil;                                     // sentinel left points to itself
+  nil->right = nil;                                    // sentinel right points to itself
+  t->nil = nil;                                        // attach sentinel to tree
+  t->root = t->nil;                                    // empty tree: root == nil
+  t->min = t->max = t->nil;                            // no extremes yet
+#ifndef RBTREE_CALLOC_NODES
+  if (capacity > 0)                            // caller knows the expected size
+    slab_grow(&t->slab, &node_kind, capacity); // preallocate one chunk of that size (on failure, grow lazily)
+#else
+  (void)capacity; // no slab to size
+#endif
+  return t; // return initialized tree
 }
 
+#ifdef RBTREE_CALLOC_NODES
 /* Purpose: Recursively free subtree nodes (post-order) and avoid freeing the sentinel node. */
 static void free_subtree(rbtree *t, node_t *n)
 {
@@ -26,13 +117,34 @@ static void free_subtree(rbtree *t, node_t *n)
   free_subtree(t, n->right);    // free right subtree
   free(n);                      // free this node
 }
+#endif
+
+/* Purpose: Remove every node but keep the tree (and its largest chunk) for reuse. */
+void rbtree_clear(rbtree *t)
+{
+  if (t == NULL) // nothing to do if tree is NULL
+    return;      // early return
+#ifdef RBTREE_CALLOC_NODES
+  free_subtree(t, t->root); // free all regular nodes
+#else
+  slab_reset(&t->slab); // keep the largest chunk, drop the rest
+#endif
+  t->root = t->nil;         // tree is empty
+  t->min = t->max = t->nil; // no extremes left
+  t->count = 0;             // no keys left
+  t->hint = NULL;           // nothing to insert next to
+}
 
 /* Purpose: Destroy the entire tree, freeing nodes, sentinel and tree struct. */
 void delete_rbtree(rbtree *t)
 {
   if (t == NULL)            // nothing to do if tree is NULL
     return;                 // early return
+#ifdef RBTREE_CALLOC_NODES
   free_subtree(t, t->root); // free all regular nodes
+#else
+  slab_release(&t->slab);   // nodes live in the slab: drop the chunks
+#endif
   free(t->nil);             // free sentinel node
   free(t);                  // free tree container
 }
@@ -40,15 +152,15 @@ void delete_rbtree(rbtree *t)
 /* Purpose: Helper transplant: replace subtree rooted at u with subtree rooted at v. */
 static void transplant(rbtree *t, node_t *u, node_t *v)
 {
-  if (u->parent == t->nil)       // if u is root
-    t->root = v;                 // v becomes new root
-  else if (u == u->parent->left) // if u is left child
-    u->parent->left = v;         // set left child to v
+  if (rbtree_parent(u) == t->nil)       // if u is root
+    t->root = v;                        // v becomes new root
+  else if (u == rbtree_parent(u)->left) // if u is left child
+    rbtree_parent(u)->left = v;         // set left child to v
   else
-    u->parent->right = v; // set right child to v
-                          // if (v != t->nil)         // if v is not sentinel
+    rbtree_parent(u)->right = v; // set right child to v
+                                 // if (v != t->nil)         // if v is not sentinel
 
-  v->parent = u->parent; // update v's parent
+  rbtree_set_parent(v, rbtree_parent(u)); // update v's parent
 }
 
 /* Purpose: Find the minimum node in subtree starting at `start`. */
@@ -60,115 +172,409 @@ node_t *subtree_min(rbtree *t, node_t *start)
   return curr;                                   // return min node (could be nil)
 }
 
+/* Purpose: Find the maximum node in subtree starting at `start`. */
+static node_t *subtree_max(rbtree *t, node_t *start)
+{
+  node_t *curr = start;                           // start from provided node
+  while (curr != t->nil && curr->right != t->nil) // traverse right while possible
+    curr = curr->right;                           // move right
+  return curr;                                    // return max node (could be nil)
+}
+
+#ifdef RBTREE_COUNTED
+#define node_dup(n) ((n)->dup) // copies of its key that n holds
+#else
+#define node_dup(n) ((size_t)1) // every node holds one key
+#endif
+
+#if defined(RBTREE_ORDER_STAT) || defined(RBTREE_INTERVAL) || defined(RBTREE_AUGMENT_UPDATE)
+/* Purpose: Recompute n's augmented fields from its children (the sentinel's fields stay zero). */
+static inline void augment_node(const rbtree *t, node_t *n)
+{
+  (void)t; // only user hooks look at the tree
+#ifdef RBTREE_ORDER_STAT
+  n->size = n->left->size + n->right->size + node_dup(n); // children plus n's own copies
+#endif
+#ifdef RBTREE_INTERVAL
+  key_t max_end = n->key < n->end ? n->end : NO_END;          // own interval, unless it is empty
+  if (n->left != t->nil && n->left->max_end > max_end)        // left subtree reaches further
+    max_end = n->left->max_end;                               // take it
+  if (n->right != t->nil && n->right->max_end > max_end)      // right subtree reaches further
+    max_end = n->right->max_end;                              // take it
+  n->max_end = max_end;                                       // furthest end below n
+#endif
+#ifdef RBTREE_AUGMENT_UPDATE
+  RBTREE_AUGMENT_UPDATE(t, n); // user summary, e.g. max endpoint or sum
+#endif
+}
+
+/* Purpose: Recompute augmented fields from n up to the root after a change right below n. */
+static void augment_path(const rbtree *t, node_t *n)
+{
+  for (; n != t->nil; n = rbtree_parent(n)) // every ancestor summarizes the changed spot
+    augment_node(t, n);                     // children are already up to date
+}
+#else
+#define augment_node(t, n) ((void)0) // no augmentation: the hooks compile away
+#define augment_path(t, n) ((void)0)
+#endif
+
 /* Purpose: Left-rotate the subtree rooted at x. */
 static void rotate_left(rbtree *t, node_t *x)
 {
-  node_t *y = x->right;          // set y
-  x->right = y->left;            // turn y's left subtree into x's right
-  if (y->left != t->nil)         // if y's left exists
-    y->left->parent = x;         // update parent
-  y->parent = x->parent;         // link y's parent to x's parent
-  if (x->parent == t->nil)       // if x was root
-    t->root = y;                 // y becomes root
-  else if (x == x->parent->left) // else if x was left child
-    x->parent->left = y;         // set left child
+  node_t *y = x->right;                   // set y
+  x->right = y->left;                     // turn y's left subtree into x's right
+  if (y->left != t->nil)                  // if y's left exists
+    rbtree_set_parent(y->left, x);        // update parent
+  rbtree_set_parent(y, rbtree_parent(x)); // link y's parent to x's parent
+  if (rbtree_parent(x) == t->nil)         // if x was root
+    t->root = y;                          // y becomes root
+  else if (x == rbtree_parent(x)->left)   // else if x was left child
+    rbtree_parent(x)->left = y;           // set left child
   else
-    x->parent->right = y; // set right child
-  y->left = x;            // put x on y's left
-  x->parent = y;          // update x's parent
+    rbtree_parent(x)->right = y; // set right child
+  y->left = x;                   // put x on y's left
+  rbtree_set_parent(x, y);       // update x's parent
+  augment_node(t, x);            // x is now y's child: recompute it first
+  augment_node(t, y);            // then y, which took x's place
+#ifdef RBTREE_STATS
+  t->rotations++; // one more for the backend comparison
+#endif
 }
 
 /* Purpose: Right-rotate the subtree rooted at x. */
 static void rotate_right(rbtree *t, node_t *x)
 {
-  node_t *y = x->left;            // set y
-  x->left = y->right;             // turn y's right subtree into x's left
-  if (y->right != t->nil)         // if y's right exists
-    y->right->parent = x;         // update parent
-  y->parent = x->parent;          // link y's parent to x's parent
-  if (x->parent == t->nil)        // if x was root
-    t->root = y;                  // y becomes root
-  else if (x == x->parent->right) // else if x was right child
-    x->parent->right = y;         // set right child
+  node_t *y = x->left;                    // set y
+  x->left = y->right;                     // turn y's right subtree into x's left
+  if (y->right != t->nil)                 // if y's right exists
+    rbtree_set_parent(y->right, x);       // update parent
+  rbtree_set_parent(y, rbtree_parent(x)); // link y's parent to x's parent
+  if (rbtree_parent(x) == t->nil)         // if x was root
+    t->root = y;                          // y becomes root
+  else if (x == rbtree_parent(x)->right)  // else if x was right child
+    rbtree_parent(x)->right = y;          // set right child
   else
-    x->parent->left = y; // set left child
-  y->right = x;          // put x on y's right
-  x->parent = y;         // update x's parent
+    rbtree_parent(x)->left = y; // set left child
+  y->right = x;                 // put x on y's right
+  rbtree_set_parent(x, y);      // update x's parent
+  augment_node(t, x);           // x is now y's child: recompute it first
+  augment_node(t, y);           // then y, which took x's place
+#ifdef RBTREE_STATS
+  t->rotations++; // one more for the backend comparison
+#endif
 }
 
+#ifdef RBTREE_CLRS
 /* Purpose: Restore red-black properties after insertion of node z. */
 static void rebuild_after_insert(rbtree *t, node_t *z)
 {
-  while (z->parent->color == RBTREE_RED) // while parent is red
+  while (rbtree_color(rbtree_parent(z)) == RBTREE_RED) // while parent is red
   {
-    if (z->parent == z->parent->parent->left) // if parent is left child
+    if (rbtree_parent(z) == rbtree_parent(rbtree_parent(z))->left) // if parent is left child
     {
-      node_t *y = z->parent->parent->right; // uncle
-      if (y->color == RBTREE_RED)           // case 1: uncle red
+      node_t *y = rbtree_parent(rbtree_parent(z))->right; // uncle
+      if (rbtree_color(y) == RBTREE_RED)                  // case 1: uncle red
       {
-        z->parent->color = RBTREE_BLACK;       // recolor parent black
-        y->color = RBTREE_BLACK;               // recolor uncle black
-        z->parent->parent->color = RBTREE_RED; // recolor grandparent red
-        z = z->parent->parent;                 // move z up
+        rbtree_set_color(rbtree_parent(z), RBTREE_BLACK);              // recolor parent black
+        rbtree_set_color(y, RBTREE_BLACK);                             // recolor uncle black
+        rbtree_set_color(rbtree_parent(rbtree_parent(z)), RBTREE_RED); // recolor grandparent red
+        z = rbtree_parent(rbtree_parent(z));                           // move z up
       }
       else
       {
-        if (z == z->parent->right) // case 2: z is right child
+        if (z == rbtree_parent(z)->right) // case 2: z is right child
         {
-          z = z->parent;     // move z up
-          rotate_left(t, z); // rotate left
+          z = rbtree_parent(z); // move z up
+          rotate_left(t, z);    // rotate left
         }
-        z->parent->color = RBTREE_BLACK;       // case 3: recolor parent
-        z->parent->parent->color = RBTREE_RED; // recolor grandparent
-        rotate_right(t, z->parent->parent);    // rotate right
+        rbtree_set_color(rbtree_parent(z), RBTREE_BLACK);              // case 3: recolor parent
+        rbtree_set_color(rbtree_parent(rbtree_parent(z)), RBTREE_RED); // recolor grandparent
+        rotate_right(t, rbtree_parent(rbtree_parent(z)));              // rotate right
       }
     }
     else // mirror
     {
-      node_t *y = z->parent->parent->left; // uncle
-      if (y->color == RBTREE_RED)          // case 1 mirror
+      node_t *y = rbtree_parent(rbtree_parent(z))->left; // uncle
+      if (rbtree_color(y) == RBTREE_RED)                 // case 1 mirror
       {
-        z->parent->color = RBTREE_BLACK;       // recolor parent
-        y->color = RBTREE_BLACK;               // recolor uncle
-        z->parent->parent->color = RBTREE_RED; // recolor grandparent
-        z = z->parent->parent;                 // move z up
+        rbtree_set_color(rbtree_parent(z), RBTREE_BLACK);              // recolor parent
+        rbtree_set_color(y, RBTREE_BLACK);                             // recolor uncle
+        rbtree_set_color(rbtree_parent(rbtree_parent(z)), RBTREE_RED); // recolor grandparent
+        z = rbtree_parent(rbtree_parent(z));                           // move z up
       }
       else
       {
-        if (z == z->parent->left) // case 2 mirror
+        if (z == rbtree_parent(z)->left) // case 2 mirror
         {
-          z = z->parent;      // move z up
-          rotate_right(t, z); // rotate right
+          z = rbtree_parent(z); // move z up
+          rotate_right(t, z);   // rotate right
         }
-        z->parent->color = RBTREE_BLACK;       // recolor parent
-        z->parent->parent->color = RBTREE_RED; // recolor grandparent
-        rotate_left(t, z->parent->parent);     // rotate left
+        rbtree_set_color(rbtree_parent(z), RBTREE_BLACK);              // recolor parent
+        rbtree_set_color(rbtree_parent(rbtree_parent(z)), RBTREE_RED); // recolor grandparent
+        rotate_left(t, rbtree_parent(rbtree_parent(z)));               // rotate left
       }
     }
   }
-  t->root->color = RBTREE_BLACK; // ensure root is black
+  rbtree_set_color(t->root, RBTREE_BLACK); // ensure root is black
 }
+#endif
 
-/* Purpose: Insert a key into the tree and return the created node pointer. */
-node_t *rbtree_insert(rbtree *t, const key_t key)
+#ifdef RBTREE_AVL
+/* Purpose: Recompute n's height from its children's. */
+static inline void avl_height(node_t *n)
 {
-  node_t *z = (node_t *)calloc(1, sizeof(node_t)); // allocate new node
-  z->key = key;                                    // set key
-  z->color = RBTREE_RED;                           // new nodes are red
-  z->left = t->nil;                                // children point to sentinel
-  z->right = t->nil;                               // children point to sentinel
+  n->rank = 1 + taller_child_rank(n); // the sentinel's -1 makes a leaf 0
+}
 
-  node_t *y = t->nil;  // y will track parent
-  node_t *x = t->root; // start from root
-  while (x != t->nil)  // find insertion point
+/* Purpose: Fix n, whose children's heights differ by two, with one or two rotations; returns the new subtree root. */
+static node_t *avl_rotate(rbtree *t, node_t *n)
+{
+  if (n->left->rank > n->right->rank) // left side is too tall
   {
-    y = x;               // update parent
-    if (z->key < x->key) // go left if key smaller
-      x = x->left;       // move left
+    node_t *l = n->left;                // child that comes up
+    if (l->right->rank > l->left->rank) // its inner subtree is the tall one
+    {
+      rotate_left(t, l); // straighten the zig-zag
+      avl_height(l);     // l moved down
+      l = n->left;       // its old right child comes up instead
+    }
+    rotate_right(t, n); // lift l over n
+    avl_height(n);      // n moved down: first
+    avl_height(l);      // then l from it
+    return l;           // new subtree root
+  }
+  node_t *r = n->right;               // mirror: right side is too tall
+  if (r->left->rank > r->right->rank) // inner subtree is the tall one
+  {
+    rotate_right(t, r); // straighten the zig-zag
+    avl_height(r);      // r moved down
+    r = n->right;       // its old left child comes up instead
+  }
+  rotate_left(t, n); // lift r over n
+  avl_height(n);     // n moved down: first
+  avl_height(r);     // then r from it
+  return r;          // new subtree root
+}
+
+/* Purpose: Restore AVL balance after inserting leaf z: update heights upwards until one stays the same or a rotation fixes it. */
+static void rebuild_after_insert(rbtree *t, node_t *z)
+{
+  for (node_t *p = rbtree_parent(z); p != t->nil; p = rbtree_parent(p))
+  {
+    const int diff = p->left->rank - p->right->rank; // balance factor
+    if (diff > 1 || diff < -1)                       // p is off by two
+    {
+      avl_rotate(t, p); // subtree gets back its old height
+      return;           // ancestors see no change
+    }
+    const int height = 1 + taller_child_rank(p); // p's height with z in
+    if (height == p->rank)                       // unchanged
+      return;                                    // ancestors see no change
+    p->rank = height;                            // grew by one: check the parent
+  }
+}
+
+/* Purpose: Restore AVL balance after a removal below x's parent (set by transplant even when x is the sentinel). */
+static void rebuild_after_delete(rbtree *t, node_t *x)
+{
+  for (node_t *p = rbtree_parent(x); p != t->nil; p = rbtree_parent(p))
+  {
+    const int before = p->rank;                      // height before the removal
+    const int diff = p->left->rank - p->right->rank; // balance factor
+    if (diff > 1 || diff < -1)                       // p is off by two
+      p = avl_rotate(t, p);                          // may leave the subtree one shorter
     else
-      x = x->right; // move right (allow duplicates to right)
+      avl_height(p);       // shorter child, or none shorter
+    if (p->rank == before) // subtree kept its height
+      return;              // ancestors see no change
+  }
+}
+#endif
+
+#ifdef RBTREE_WAVL
+/* Purpose: Restore the WAVL rank rule (rank differences 1 or 2) after inserting leaf x: promote upwards, then rotate at most twice. */
+static void rebuild_after_insert(rbtree *t, node_t *x)
+{
+  node_t *p = rbtree_parent(x);             // x's parent
+  while (p != t->nil && p->rank == x->rank) // x is a 0-child
+  {
+    const int left = x == p->left;               // side x hangs from
+    const node_t *s = left ? p->right : p->left; // x's sibling
+    if (p->rank - s->rank == 1)                  // 0,1 node
+    {
+      p->rank++;            // promote: p's own difference may drop to 0
+      x = p;                // check one level up
+      p = rbtree_parent(p); // move up
+      continue;             // next level
+    }
+    node_t *y = left ? x->right : x->left; // 0,2 node: x's inner child decides the rotation
+    if (x->rank - y->rank == 2)            // inner child is low: single rotation
+    {
+      if (left)             // x comes up from the left
+        rotate_right(t, p); // lift x over p
+      else
+        rotate_left(t, p); // lift x over p
+      p->rank--;           // p moved down
+    }
+    else // inner child is a 1-child: double rotation brings y up
+    {
+      if (left) // zig-zag from the left
+      {
+        rotate_left(t, x);  // straighten it
+        rotate_right(t, p); // lift y over p
+      }
+      else
+      {
+        rotate_right(t, x); // straighten it
+        rotate_left(t, p);  // lift y over p
+      }
+      y->rank++; // y took the top
+      x->rank--; // x and p moved down
+      p->rank--; // x and p moved down
+    }
+    return; // subtree keeps its old rank
   }
-  z->parent = y;            // set parent
+}
+
+/* Purpose: Restore the WAVL rank rule after a removal below x's parent: demote upwards, then rotate at most twice. */
+static void rebuild_after_delete(rbtree *t, node_t *x)
+{
+  node_t *p = rbtree_parent(x);                                               // set by transplant when x is the sentinel
+  if (p != t->nil && p->left == t->nil && p->right == t->nil && p->rank == 1) // p became a 2,2 leaf
+  {
+    p->rank = 0;          // leaves have rank 0
+    x = p;                // p may now be a 3-child
+    p = rbtree_parent(p); // move up
+  }
+  while (p != t->nil && p->rank - x->rank == 3) // x is a 3-child
+  {
+    const int left = x == p->left;                                          // side x hangs from (the sentinel only hangs from one side here)
+    node_t *y = left ? p->right : p->left;                                  // x's sibling
+    if (p->rank - y->rank == 2)                                             // sibling is a 2-child
+      p->rank--;                                                            // demote p
+    else if (y->rank - y->left->rank == 2 && y->rank - y->right->rank == 2) // sibling is a 2,2 node
+    {
+      p->rank--; // demote both
+      y->rank--; // demote both
+    }
+    else // y has a 1-child: rotate
+    {
+      node_t *v = left ? y->left : y->right;       // y's inner child
+      const node_t *w = left ? y->right : y->left; // y's outer child
+      if (y->rank - w->rank == 1)                  // outer child is a 1-child: single rotation
+      {
+        if (left)            // y comes up from the right
+          rotate_left(t, p); // lift y over p
+        else
+          rotate_right(t, p);                        // lift y over p
+        y->rank++;                                   // y took the top
+        p->rank--;                                   // p moved down
+        if (p->left == t->nil && p->right == t->nil) // p ended up a leaf
+          p->rank--;                                 // leaves have rank 0
+      }
+      else // double rotation brings v up
+      {
+        if (left) // zig-zag from the right
+        {
+          rotate_right(t, y); // straighten it
+          rotate_left(t, p);  // lift v over p
+        }
+        else
+        {
+          rotate_left(t, y);  // straighten it
+          rotate_right(t, p); // lift v over p
+        }
+        v->rank += 2; // v took the top
+        y->rank--;    // y moved down
+        p->rank -= 2; // p moved down
+      }
+      return; // subtree keeps its old rank
+    }
+    x = p;                // p shrank: check one level up
+    p = rbtree_parent(p); // move up
+  }
+}
+#endif
+
+#ifdef RBTREE_LLRB
+#define is_red(n) (rbtree_color(n) == RBTREE_RED) // the sentinel is black
+
+/* Purpose: Rotate h's red right link to the left, keeping h's color at the top; returns the new subtree root. */
+static node_t *lean_left(rbtree *t, node_t *h)
+{
+  node_t *x = h->right;                 // red child that comes up
+  rotate_left(t, h);                    // lift it over h
+  rbtree_set_color(x, rbtree_color(h)); // x takes h's color
+  rbtree_set_color(h, RBTREE_RED);      // h is the red link now
+  return x;                             // new subtree root
+}
+
+/* Purpose: Rotate h's red left link to the right, keeping h's color at the top; returns the new subtree root. */
+static node_t *lean_right(rbtree *t, node_t *h)
+{
+  node_t *x = h->left;                  // red child that comes up
+  rotate_right(t, h);                   // lift it over h
+  rbtree_set_color(x, rbtree_color(h)); // x takes h's color
+  rbtree_set_color(h, RBTREE_RED);      // h is the red link now
+  return x;                             // new subtree root
+}
+
+#define flip_color(n) rbtree_set_color((n), is_red(n) ? RBTREE_BLACK : RBTREE_RED) // toggle one node
+
+/* Purpose: Toggle h and its children's colors: split a 4-node (or, on the way down, merge one); the sentinel stays black. */
+static void flip_colors(const rbtree *t, node_t *h)
+{
+  flip_color(h);          // h joins or leaves its parent's node
+  if (h->left != t->nil)  // real child
+    flip_color(h->left);  // toggle it
+  if (h->right != t->nil) // real child
+    flip_color(h->right); // toggle it
+}
+
+/* Purpose: Restore left-leaning at h: lean a red right link left, split two reds in a row, push up a 4-node; returns the subtree root. */
+static node_t *llrb_balance(rbtree *t, node_t *h)
+{
+  if (is_red(h->right) && !is_red(h->left))     // right-leaning red link
+    h = lean_left(t, h);                        // lean it left
+  if (is_red(h->left) && is_red(h->left->left)) // two reds in a row
+    h = lean_right(t, h);                       // balance them around h
+  if (is_red(h->left) && is_red(h->right))      // 4-node
+    flip_colors(t, h);                          // split it
+  return h;                                     // subtree root
+}
+
+/* Purpose: Restore left-leaning red-black properties after inserting red leaf z, balancing each node on its path. */
+static void rebuild_after_insert(rbtree *t, node_t *z)
+{
+  node_t *h = rbtree_parent(z); // z itself is balanced
+  while (h != t->nil)           // up to the root
+  {
+    const color_t before = rbtree_color(h);                              // color before balancing
+    node_t *top = llrb_balance(t, h);                                    // may rotate or flip
+    if (top == h && before == RBTREE_BLACK && rbtree_color(h) == before) // nothing changed above h
+      break;                                                             // the rest of the path was fine before
+    h = rbtree_parent(top);                                              // next level
+  }
+  rbtree_set_color(t->root, RBTREE_BLACK); // ensure root is black
+}
+
+/* Purpose: Balance every node of subtree n children first, turning a depth-colored build into a left-leaning one. */
+static void lean_subtree(rbtree *t, node_t *n)
+{
+  if (n == t->nil)           // nothing below a leaf
+    return;                  // done
+  lean_subtree(t, n->left);  // left subtree first
+  lean_subtree(t, n->right); // then right subtree
+  llrb_balance(t, n);        // then n
+}
+#endif
+
+/* Purpose: Hang red node z below y, the last node of its search path (t->nil for an empty tree), then rebalance.
+   prev and next are z's in-order neighbours (NULL at either end); z becomes the tree's insertion hint. */
+static void attach_leaf(rbtree *t, node_t *z, node_t *y, node_t *prev, node_t *next)
+{
+  rbtree_set_parent(z, y);  // set parent
   if (y == t->nil)          // if tree was empty
     t->root = z;            // new node is root
   else if (z->key < y->key) // attach as left child
@@ -176,8 +582,192 @@ node_t *rbtree_insert(rbtree *t, const key_t key)
   else
     y->right = z; // set right pointer
 
+  augment_path(t, z);         // summaries on the path now include z
   rebuild_after_insert(t, z); // fix red-black properties
-  return z;                   // return new node
+  if (prev == NULL)           // nothing precedes z
+    t->min = z;               // new minimum
+  if (next == NULL)           // nothing follows z
+    t->max = z;               // new maximum
+  t->count++;                 // one more key
+  t->hint = z;                // the next key of a sorted stream lands right next to z
+  t->hint_prev = prev;        // rotations keep the in-order neighbours
+  t->hint_next = next;        // so these stay valid until one of the three is erased
+}
+
+/* Purpose: Attach red node z at the leaf position its key belongs to, descending from the root, then rebalance. */
+static void insert_below(rbtree *t, node_t *z)
+{
+  node_t *y = t->nil;  // y will track parent
+  node_t *prev = NULL; // last node we went right at: z's predecessor
+  node_t *next = NULL; // last node we went left at: z's successor
+  node_t *x = t->root; // start from root
+  while (x != t->nil)  // find insertion point
+  {
+    y = x;               // update parent
+    if (z->key < x->key) // go left if key smaller
+    {
+      next = x;    // x follows z in key order
+      x = x->left; // move left
+    }
+    else
+    {
+      prev = x;     // x precedes z in key order
+      x = x->right; // move right (allow duplicates to right)
+    }
+  }
+  attach_leaf(t, z, y, prev, next); // link and rebalance
+}
+
+/* Purpose: Take a node from the tree's slab and fill it as a fresh red leaf holding key. */
+static node_t *new_node(rbtree *t, const key_t key)
+{
+  node_t *z = node_alloc(t); // take a node from the tree's slab
+  if (z == NULL)             // out of memory
+    return NULL;             // nothing created
+  z->key = key;              // set key
+  mark_leaf(z);              // red, or rank 0
+  z->left = t->nil;          // children point to sentinel
+  z->right = t->nil;         // children point to sentinel
+#ifdef RBTREE_INTERVAL
+  z->end = key; // plain keys are empty intervals [key, key)
+#endif
+#ifdef RBTREE_MAP
+  memset(&z->value, 0, sizeof(z->value)); // recycled nodes still hold an old payload
+#endif
+#ifdef RBTREE_COUNTED
+  z->dup = 1; // one copy so far
+#endif
+  return z; // caller links it
+}
+
+#if defined(RBTREE_MAP) || defined(RBTREE_COUNTED)
+/* Purpose: One descent for key: return a node holding it, or NULL with *parent and the neighbours-to-be *prev, *next set. */
+static node_t *find_slot(const rbtree *t, const key_t key, node_t **parent, node_t **prev, node_t **next)
+{
+  node_t *y = t->nil;  // last node on the path
+  node_t *x = t->root; // start from root
+  *prev = *next = NULL; // no neighbour seen yet
+  while (x != t->nil)  // same walk as rbtree_find
+  {
+    if (key == x->key) // present
+      return x;        // caller updates it in place
+    y = x;             // remember parent
+    if (key < x->key)  // go left if key smaller
+    {
+      *next = x;   // x follows key in order
+      x = x->left; // move left
+    }
+    else
+    {
+      *prev = x;    // x precedes key in order
+      x = x->right; // move right
+    }
+  }
+  *parent = y; // insertion point for a new node
+  return NULL; // absent
+}
+#endif
+
+#ifdef RBTREE_COUNTED
+/* Purpose: Count one more copy of n's key: no allocation and no rebalancing. */
+static node_t *add_copy(rbtree *t, node_t *n)
+{
+  n->dup++;           // one more copy
+  t->count++;         // one more key
+  augment_path(t, n); // subtree sizes count copies
+  return n;           // the key's node
+}
+#endif
+
+/* Purpose: Insert key right after h, whose successor is next (NULL if h is the max), without a descent; NULL if it belongs elsewhere. */
+static node_t *insert_after(rbtree *t, const key_t key, node_t *h, node_t *next)
+{
+  if (key < h->key || (next != NULL && !(key < next->key))) // key is not between h and next
+    return NULL;                                            // caller descends from the root
+#ifdef RBTREE_COUNTED
+  if (key == h->key)        // h already holds the key
+    return add_copy(t, h);  // count it there
+#endif
+  node_t *z = new_node(t, key); // allocate new node
+  if (z == NULL)                // out of memory
+    return NULL;                // nothing inserted
+  attach_leaf(t, z, h->right == t->nil ? h : next, h, next); // h's right slot, else next's empty left slot
+  return z;                                                  // return new node
+}
+
+/* Purpose: Insert key right before h, whose predecessor is prev (NULL if h is the min), without a descent; NULL if it belongs elsewhere. */
+static node_t *insert_before(rbtree *t, const key_t key, node_t *h, node_t *prev)
+{
+  if (!(key < h->key) || (prev != NULL && key < prev->key)) // key is not between prev and h
+    return NULL;                                            // caller descends from the root
+#ifdef RBTREE_COUNTED
+  if (prev != NULL && key == prev->key) // prev already holds the key
+    return add_copy(t, prev);           // count it there
+#endif
+  node_t *z = new_node(t, key); // allocate new node
+  if (z == NULL)                // out of memory
+    return NULL;                // nothing inserted
+  attach_leaf(t, z, h->left == t->nil ? h : prev, prev, h); // h's left slot, else prev's empty right slot
+  return z;                                                 // return new node
+}
+
+/* Purpose: Insert a key into the tree and return the created node pointer (in counted builds, the key's node). */
+node_t *rbtree_insert(rbtree *t, const key_t key)
+{
+  if (t->hint != NULL) // try next to the last insertion first: two compares on hot nodes
+  {
+    node_t *z = key < t->hint->key ? insert_before(t, key, t->hint, t->hint_prev)  // descending streams
+                                   : insert_after(t, key, t->hint, t->hint_next); // ascending streams
+    if (z != NULL) // key was a neighbour of the hint
+      return z;    // no descent
+  }
+#ifdef RBTREE_COUNTED
+  node_t *y, *prev, *next;
+  node_t *z = find_slot(t, key, &y, &prev, &next); // one walk from the root
+  if (z != NULL)                                   // key already present
+    return add_copy(t, z);                         // no allocation, no rebalancing
+  z = new_node(t, key);             // allocate new node
+  if (z == NULL)                    // out of memory
+    return NULL;                    // nothing inserted
+  attach_leaf(t, z, y, prev, next); // hang it where the descent ended
+  return z;                         // return new node
+#else
+  node_t *z = new_node(t, key); // allocate new node
+  if (z == NULL)                // out of memory
+    return NULL;                // nothing inserted
+  insert_below(t, z);           // descend from the root
+  return z;                     // return new node
+#endif
+}
+
+/* Purpose: Insert key next to hint when it belongs there (O(1) amortized before the fixup), else like rbtree_insert. */
+node_t *rbtree_insert_hint(rbtree *t, const key_t key, node_t *hint)
+{
+  if (t == NULL)                         // invalid input
+    return NULL;                         // nothing inserted
+  if (hint != NULL && hint != t->nil)    // a node of this tree
+  {
+    node_t *z = key < hint->key ? insert_before(t, key, hint, hint == t->hint ? t->hint_prev : rbtree_prev(t, hint)) // left neighbour
+                                : insert_after(t, key, hint, hint == t->hint ? t->hint_next : rbtree_next(t, hint)); // right neighbour
+    if (z != NULL) // fit next to hint
+      return z;    // no descent
+  }
+  return rbtree_insert(t, key); // hint was off: full descent
+}
+
+/* Purpose: Link a caller-owned node whose key is already set, without allocating; returns it. */
+node_t *rbtree_insert_node(rbtree *t, node_t *z)
+{
+  if (t == NULL || z == NULL) // invalid input
+    return NULL;              // nothing linked
+  mark_leaf(z);               // red, or rank 0
+  z->left = t->nil;           // children point to sentinel
+  z->right = t->nil;          // children point to sentinel
+#ifdef RBTREE_COUNTED
+  z->dup = 1; // never merged with another node of the same key
+#endif
+  insert_below(t, z); // descend from the root
+  return z;           // caller still owns it
 }
 
 /* Purpose: Find a node by key. Returns pointer to node or NULL if not found. */
@@ -196,163 +786,895 @@ node_t *rbtree_find(const rbtree *t, const key_t key)
   return NULL; // not found: tests expect NULL
 }
 
-/* Purpose: Return pointer to minimum element in tree (or t->nil if empty). */
+/* Purpose: Return pointer to minimum element in tree (or t->nil if empty) in O(1). */
 node_t *rbtree_min(const rbtree *t)
 {
-  node_t *curr = t->root;                        // start from root
-  while (curr != t->nil && curr->left != t->nil) // traverse left
-    curr = curr->left;                           // move left
-  return curr;                                   // return min or nil
+  return t->min; // kept up to date by every insert and erase
 }
 
-/* Purpose: Return pointer to maximum element in tree (or t->nil if empty). */
+/* Purpose: Return pointer to maximum element in tree (or t->nil if empty) in O(1). */
 node_t *rbtree_max(const rbtree *t)
 {
-  node_t *curr = t->root;                         // start from root
-  while (curr != t->nil && curr->right != t->nil) // traverse right
-    curr = curr->right;                           // move right
-  return curr;                                    // return max or nil
+  return t->max; // kept up to date by every insert and erase
+}
+
+/* Purpose: Return the first node (in order) with key >= key, or NULL if every key is smaller. */
+node_t *rbtree_lower_bound(const rbtree *t, const key_t key)
+{
+  node_t *best = NULL;    // best candidate so far
+  node_t *curr = t->root; // start from root
+  while (curr != t->nil)  // traverse until sentinel
+  {
+    if (curr->key >= key) // curr qualifies
+    {
+      best = curr;       // remember it
+      curr = curr->left; // look for an earlier one
+    }
+    else
+      curr = curr->right; // too small: go right
+  }
+  return best; // first qualifying node or NULL
+}
+
+/* Purpose: Return the first node (in order) with key > key, or NULL if no key is larger. */
+node_t *rbtree_upper_bound(const rbtree *t, const key_t key)
+{
+  node_t *best = NULL;    // best candidate so far
+  node_t *curr = t->root; // start from root
+  while (curr != t->nil)  // traverse until sentinel
+  {
+    if (curr->key > key) // curr qualifies
+    {
+      best = curr;       // remember it
+      curr = curr->left; // look for an earlier one
+    }
+    else
+      curr = curr->right; // too small or equal: go right
+  }
+  return best; // first qualifying node or NULL
+}
+
+/* Purpose: Return the in-order successor of p using parent pointers, or NULL after the last node. */
+node_t *rbtree_next(const rbtree *t, const node_t *p)
+{
+  if (p == NULL || p == t->nil) // invalid input
+    return NULL;                // nothing follows
+  if (p->right != t->nil)       // successor is the leftmost node of the right subtree
+  {
+    node_t *curr = p->right;     // step right once
+    while (curr->left != t->nil) // then all the way left
+      curr = curr->left;         // move left
+    return curr;                 // successor
+  }
+  while (rbtree_parent(p) != t->nil && p == rbtree_parent(p)->right) // climb while coming from the right
+    p = rbtree_parent(p);                                            // move up
+  return rbtree_parent(p) == t->nil ? NULL : rbtree_parent(p);       // first ancestor reached from the left
+}
+
+/* Purpose: Return the in-order predecessor of p using parent pointers, or NULL before the first node. */
+node_t *rbtree_prev(const rbtree *t, const node_t *p)
+{
+  if (p == NULL || p == t->nil) // invalid input
+    return NULL;                // nothing precedes
+  if (p->left != t->nil)        // predecessor is the rightmost node of the left subtree
+  {
+    node_t *curr = p->left;       // step left once
+    while (curr->right != t->nil) // then all the way right
+      curr = curr->right;         // move right
+    return curr;                  // predecessor
+  }
+  while (rbtree_parent(p) != t->nil && p == rbtree_parent(p)->left) // climb while coming from the left
+    p = rbtree_parent(p);                                           // move up
+  return rbtree_parent(p) == t->nil ? NULL : rbtree_parent(p);      // first ancestor reached from the right
 }
 
+#ifdef RBTREE_CLRS
 /* Purpose: Restore red-black properties after deletion. */
 static void rebuild_after_delete(rbtree *t, node_t *x)
 {
-  while (x != t->root && x->color == RBTREE_BLACK) // while x is double-black
+  while (x != t->root && rbtree_color(x) == RBTREE_BLACK) // while x is double-black
   {
-    if (x == x->parent->left) // if x is left child
+    if (x == rbtree_parent(x)->left) // if x is left child
     {
-      node_t *w = x->parent->right; // sibling
-      if (w->color == RBTREE_RED)   // case 1
+      node_t *w = rbtree_parent(x)->right; // sibling
+      if (rbtree_color(w) == RBTREE_RED)   // case 1
       {
-        w->color = RBTREE_BLACK;       // recolor sibling
-        x->parent->color = RBTREE_RED; // recolor parent
-        rotate_left(t, x->parent);     // rotate left
-        w = x->parent->right;          // update sibling
+        rbtree_set_color(w, RBTREE_BLACK);              // recolor sibling
+        rbtree_set_color(rbtree_parent(x), RBTREE_RED); // recolor parent
+        rotate_left(t, rbtree_parent(x));               // rotate left
+        w = rbtree_parent(x)->right;                    // update sibling
       }
-      if (w->left->color == RBTREE_BLACK && w->right->color == RBTREE_BLACK) // case 2
+      if (rbtree_color(w->left) == RBTREE_BLACK && rbtree_color(w->right) == RBTREE_BLACK) // case 2
       {
-        w->color = RBTREE_RED; // recolor sibling
-        x = x->parent;         // move x up
+        rbtree_set_color(w, RBTREE_RED); // recolor sibling
+        x = rbtree_parent(x);            // move x up
       }
       else
       {
-        if (w->right->color == RBTREE_BLACK) // case 3
+        if (rbtree_color(w->right) == RBTREE_BLACK) // case 3
         {
-          w->left->color = RBTREE_BLACK; // recolor
-          w->color = RBTREE_RED;         // recolor
-          rotate_right(t, w);            // rotate right
-          w = x->parent->right;          // update sibling
+          rbtree_set_color(w->left, RBTREE_BLACK); // recolor
+          rbtree_set_color(w, RBTREE_RED);         // recolor
+          rotate_right(t, w);                      // rotate right
+          w = rbtree_parent(x)->right;             // update sibling
         }
-        w->color = x->parent->color;     // case 4
-        x->parent->color = RBTREE_BLACK; // recolor
-        w->right->color = RBTREE_BLACK;  // recolor
-        rotate_left(t, x->parent);       // rotate left
-        x = t->root;                     // finish
+        rbtree_set_color(w, rbtree_color(rbtree_parent(x))); // case 4
+        rbtree_set_color(rbtree_parent(x), RBTREE_BLACK);    // recolor
+        rbtree_set_color(w->right, RBTREE_BLACK);            // recolor
+        rotate_left(t, rbtree_parent(x));                    // rotate left
+        x = t->root;                                         // finish
       }
     }
     else // mirror cases when x is right child
     {
-      node_t *w = x->parent->left; // sibling
-      if (w->color == RBTREE_RED)  // case 1 mirror
+      node_t *w = rbtree_parent(x)->left; // sibling
+      if (rbtree_color(w) == RBTREE_RED)  // case 1 mirror
       {
-        w->color = RBTREE_BLACK;       // recolor
-        x->parent->color = RBTREE_RED; // recolor
-        rotate_right(t, x->parent);    // rotate right
-        w = x->parent->left;           // update sibling
+        rbtree_set_color(w, RBTREE_BLACK);              // recolor
+        rbtree_set_color(rbtree_parent(x), RBTREE_RED); // recolor
+        rotate_right(t, rbtree_parent(x));              // rotate right
+        w = rbtree_parent(x)->left;                     // update sibling
       }
-      if (w->right->color == RBTREE_BLACK && w->left->color == RBTREE_BLACK) // case 2 mirror
+      if (rbtree_color(w->right) == RBTREE_BLACK && rbtree_color(w->left) == RBTREE_BLACK) // case 2 mirror
       {
-        w->color = RBTREE_RED; // recolor
-        x = x->parent;         // move x up
+        rbtree_set_color(w, RBTREE_RED); // recolor
+        x = rbtree_parent(x);            // move x up
       }
       else
       {
-        if (w->left->color == RBTREE_BLACK) // case 3 mirror
+        if (rbtree_color(w->left) == RBTREE_BLACK) // case 3 mirror
         {
-          w->right->color = RBTREE_BLACK; // recolor
-          w->color = RBTREE_RED;          // recolor
-          rotate_left(t, w);              // rotate left
-          w = x->parent->left;            // update sibling
+          rbtree_set_color(w->right, RBTREE_BLACK); // recolor
+          rbtree_set_color(w, RBTREE_RED);          // recolor
+          rotate_left(t, w);                        // rotate left
+          w = rbtree_parent(x)->left;               // update sibling
         }
-        w->color = x->parent->color;     // case 4 mirror
-        x->parent->color = RBTREE_BLACK; // recolor
-        w->left->color = RBTREE_BLACK;   // recolor
-        rotate_right(t, x->parent);      // rotate right
-        x = t->root;                     // finish
+        rbtree_set_color(w, rbtree_color(rbtree_parent(x))); // case 4 mirror
+        rbtree_set_color(rbtree_parent(x), RBTREE_BLACK);    // recolor
+        rbtree_set_color(w->left, RBTREE_BLACK);             // recolor
+        rotate_right(t, rbtree_parent(x));                   // rotate right
+        x = t->root;                                         // finish
+      }
+    }
+  }
+  rbtree_set_color(x, RBTREE_BLACK); // ensure x is black
+}
+#endif
+
+/* Purpose: Drop z from the insertion hint and the cached min/max before it is unlinked. */
+static void forget_node(rbtree *t, node_t *z)
+{
+  if (z == t->hint || z == t->hint_prev || z == t->hint_next) // the hint's neighbourhood changes
+    t->hint = NULL;                                           // next insert descends from the root
+  node_t *x = z->left != t->nil ? z->left : z->right;         // an extreme has at most this one child
+  node_t *up = x != t->nil ? x : rbtree_parent(z);            // neighbour of an extreme z: its child, else its parent
+  if (z == t->min)                                            // removing the minimum
+    t->min = up;                                              // nil once the tree is empty
+  if (z == t->max)                                            // removing the maximum
+    t->max = up;                                              // nil once the tree is empty
+}
+
+#ifdef RBTREE_LLRB
+/* Purpose: Tell which side of h (an ancestor of z or z itself) z is on: -1 left, 0 h is z, 1 right. */
+static int llrb_side(const node_t *h, const node_t *z)
+{
+  if (z->key != h->key)              // keys decide
+    return z->key < h->key ? -1 : 1; // smaller keys are on the left
+  if (z == h)                        // found
+    return 0;                        // h is z
+  while (rbtree_parent(z) != h)      // equal keys may sit on either side: climb to h's child
+    z = rbtree_parent(z);            // move up
+  return z == h->left ? -1 : 1;      // the child z came up through
+}
+
+/* Purpose: Make h's left child or one of its children red before descending left; returns the subtree root. */
+static node_t *move_red_left(rbtree *t, node_t *h)
+{
+  flip_colors(t, h);          // borrow from h
+  if (is_red(h->right->left)) // sibling can lend a key
+  {
+    lean_right(t, h->right); // bring it up on the right
+    h = lean_left(t, h);     // and over h
+    flip_colors(t, h);       // give h's red back
+  }
+  return h; // subtree root
+}
+
+/* Purpose: Make h's right child or one of its children red before descending right; returns the subtree root. */
+static node_t *move_red_right(rbtree *t, node_t *h)
+{
+  flip_colors(t, h);         // borrow from h
+  if (is_red(h->left->left)) // sibling can lend a key
+  {
+    h = lean_right(t, h); // lift it over h
+    flip_colors(t, h);    // give h's red back
+  }
+  return h; // subtree root
+}
+
+/* Purpose: Unlink node z with Sedgewick's descent, which keeps the current node red so a red leaf is removed; z's memory is left to the caller. */
+static void unlink_node(rbtree *t, node_t *z)
+{
+  forget_node(t, z); // node identities survive the rotations below
+
+  node_t *h = t->root;                       // descent starts at the root
+  if (!is_red(h->left) && !is_red(h->right)) // root is a 2-node
+    rbtree_set_color(h, RBTREE_RED);         // let the descent borrow from it
+  node_t *up;                                // lowest node whose subtree changed
+  for (;;)
+  {
+    int side = llrb_side(h, z); // where z is below h
+    if (side < 0)               // z is on the left
+    {
+      if (!is_red(h->left) && !is_red(h->left->left)) // left child is a 2-node
+        h = move_red_left(t, h);                      // z stays in the new root's left subtree
+      h = h->left;                                    // descend
+      continue;                                       // next level
+    }
+    if (is_red(h->left)) // lean the red link right so one can be passed down that side
+    {
+      h = lean_right(t, h); // z is now in the right subtree
+      side = 1;             // of the new subtree root
+    }
+    if (side == 0 && h->right == t->nil) // z is a red leaf
+    {
+      up = rbtree_parent(h);    // lowest surviving ancestor
+      transplant(t, h, t->nil); // drop it
+      break;                    // done descending
+    }
+    if (!is_red(h->right) && !is_red(h->right->left)) // right child is a 2-node
+    {
+      node_t *top = move_red_right(t, h); // may rotate z down to the right
+      if (top != h)                       // it did
+        side = 1;                         // z is in the new root's right subtree
+      h = top;                            // subtree root
+    }
+    if (side == 0) // z has two children: its successor, a red leaf once reached, takes its place
+    {
+      node_t *m = h->right; // successor is the minimum of the right subtree
+      while (m->left != t->nil)
+      {
+        if (!is_red(m->left) && !is_red(m->left->left)) // left child is a 2-node
+          m = move_red_left(t, m);                      // borrow on the way down
+        m = m->left;                                    // descend
       }
+      up = rbtree_parent(m);                // lowest node whose subtree changed
+      transplant(t, m, m->right);           // cut the leaf out (its right is the sentinel)
+      if (up == z)                          // m was z's right child
+        up = m;                             // m will stand where z is
+      transplant(t, z, m);                  // m takes z's place
+      m->left = z->left;                    // and its children
+      m->right = z->right;                  // and its children
+      rbtree_set_parent(m->left, m);        // relink (the sentinel's parent is scratch)
+      rbtree_set_parent(m->right, m);       // relink
+      rbtree_set_color(m, rbtree_color(z)); // and its color
+      break;                                // done descending
     }
+    h = h->right; // z is on the right
+  }
+
+  for (node_t *p = up; p != t->nil; p = rbtree_parent(p)) // rebalance the path back up, like the recursion would
+  {
+    augment_node(t, p);     // a node is gone below p
+    p = llrb_balance(t, p); // undo the descent's borrowing
   }
-  x->color = RBTREE_BLACK; // ensure x is black
+  if (t->root != t->nil)                     // tree is not empty
+    rbtree_set_color(t->root, RBTREE_BLACK); // ensure root is black
+  t->count--;                                // one key less
+}
+#else
+/* Purpose: Unlink node z whose only child is x (possibly nil) and rebalance; z's memory is left to the caller.
+   The min and max have at most one child, a red leaf, so this is the whole of pop_min/pop_max. */
+static void unlink_leaf_side(rbtree *t, node_t *z, node_t *x)
+{
+  forget_node(t, z); // hint and extremes
+
+  const int unbalances = removal_unbalances(z); // a black node, or any ranked one, is leaving
+  transplant(t, z, x);                          // x takes z's place (sets nil->parent when x is nil)
+  augment_path(t, rbtree_parent(x));            // lowest node whose subtree changed
+  if (unbalances)                               // a path got shorter
+    rebuild_after_delete(t, x);                 // restore the backend's balance
+  t->count--;                                   // one key less
 }
 
+/* Purpose: Unlink node z and rebalance; z's memory is left to the caller. */
+static void unlink_node(rbtree *t, node_t *z)
+{
+  if (z->left == t->nil) // if left child is nil
+  {
+    unlink_leaf_side(t, z, z->right); // right child will replace z
+    return;                           // done
+  }
+  if (z->right == t->nil) // if right child is nil
+  {
+    unlink_leaf_side(t, z, z->left); // left child will replace z
+    return;                          // done
+  }
+
+  forget_node(t, z); // both children exist: z is neither the min nor the max
+
+  node_t *y = subtree_min(t, z->right);         // successor is minimum in right subtree: y leaves its spot
+  node_t *x = y->right;                         // x is successor's right child, which replaces y
+  const int unbalances = removal_unbalances(y); // y's old spot is the one that loses a node
+  if (rbtree_parent(y) == z)                    // if successor is direct child
+  {
+    rbtree_set_parent(x, y); // set x's parent to successor (may set nil->parent)
+  }
+  else
+  {
+    transplant(t, y, y->right);     // replace successor with its right child
+    y->right = z->right;            // move z's right subtree under y
+    rbtree_set_parent(y->right, y); // fix parent
+  }
+  transplant(t, z, y);           // replace z with successor
+  y->left = z->left;             // attach z's left subtree to y
+  rbtree_set_parent(y->left, y); // fix parent
+  copy_balance(y, z);            // copy color or rank
+
+  augment_path(t, rbtree_parent(x)); // x->parent is the lowest node whose subtree changed (also when x is nil)
+
+  if (unbalances) // a path got shorter
+  {
+    rebuild_after_delete(t, x); // restore the backend's balance
+  }
+
+  t->count--; // one key less
+}
+#endif
+
 /* Purpose: Erase node p from the tree and free its memory. */
 int rbtree_erase(rbtree *t, node_t *p)
 {
   if (t == NULL || p == NULL || p == t->nil) // invalid input
     return 0;                                // nothing done
+#ifdef RBTREE_COUNTED
+  if (p->dup > 1) // other copies stay
+  {
+    p->dup--;           // drop one copy
+    t->count--;         // one key less
+    augment_path(t, p); // subtree sizes count copies
+    return 1;           // node stays linked
+  }
+#endif
+  unlink_node(t, p); // detach and rebalance
+  node_free(t, p);   // recycle removed node
+  return 1;          // success
+}
 
-  node_t *z = p;                       // node to remove
-  node_t *y = z;                       // y will point to node actually removed
-  node_t *x = NULL;                    // x will point to child that replaces y
-  color_t y_original_color = y->color; // save original color
+/* Purpose: Erase one copy of the extreme node e (t->min or t->max) whose only possible child is x, writing its key. */
+static int pop_end(rbtree *t, node_t *e, node_t *x, key_t *key)
+{
+  if (key != NULL) // caller wants the key
+    *key = e->key; // copy it before the node is recycled
+#ifdef RBTREE_COUNTED
+  if (e->dup > 1) // other copies stay
+  {
+    e->dup--;           // drop one copy
+    t->count--;         // one key less
+    augment_path(t, e); // subtree sizes count copies
+    return 1;           // node stays linked
+  }
+#endif
+#ifdef RBTREE_LLRB
+  (void)x;           // the descent finds e's neighbourhood itself
+  unlink_node(t, e); // from the root down
+#else
+  unlink_leaf_side(t, e, x); // no successor search: x is nil or a red leaf
+#endif
+  node_free(t, e);           // recycle removed node
+  return 1;                  // success
+}
 
-  if (z->left == t->nil) // if left child is nil
+/* Purpose: Remove the smallest key, storing it in *key (if not NULL); return 0 if the tree is empty. */
+int rbtree_pop_min(rbtree *t, key_t *key)
+{
+  if (t == NULL || t->min == t->nil)             // nothing to pop
+    return 0;                                    // nothing done
+  return pop_end(t, t->min, t->min->right, key); // the min has no left child
+}
+
+/* Purpose: Remove the largest key, storing it in *key (if not NULL); return 0 if the tree is empty. */
+int rbtree_pop_max(rbtree *t, key_t *key)
+{
+  if (t == NULL || t->max == t->nil)            // nothing to pop
+    return 0;                                   // nothing done
+  return pop_end(t, t->max, t->max->left, key); // the max has no right child
+}
+
+/* Purpose: Unlink a caller-owned node linked by rbtree_insert_node; nothing is freed. */
+int rbtree_remove_node(rbtree *t, node_t *p)
+{
+  if (t == NULL || p == NULL || p == t->nil) // invalid input
+    return 0;                                // nothing done
+  unlink_node(t, p);                         // detach and rebalance
+  return 1;                                  // p belongs to the caller again
+}
+
+/* Purpose: In-order traversal copying up to n keys into arr. */
+static int in_order_copy(const rbtree *t, node_t *n, key_t *arr, const size_t nslots, int idx)
+{
+  if (n == t->nil || idx >= (int)nslots)                        // stop if nil or array full
+    return idx;                                                 // return current index
+  idx = in_order_copy(t, n->left, arr, nslots, idx);            // traverse left
+  for (size_t c = node_dup(n); c > 0 && idx < (int)nslots; c--) // every copy, while room is left
+    arr[idx++] = n->key;                                        // store key
+  idx = in_order_copy(t, n->right, arr, nslots, idx);           // traverse right
+  return idx;                                                   // return updated index
+}
+
+/* Purpose: Copy up to n keys into arr in order and return how many were copied. */
+int rbtree_to_array(const rbtree *t, key_t *arr, const size_t n)
+{
+  if (t == NULL || arr == NULL || n == 0)       // validate args
+    return 0;                                   // nothing copied
+  const int idx = in_order_copy(t, t->root, arr, n, 0); // fill array
+  return idx < (int)n ? idx : (int)n;           // keys actually written
+}
+
+/* Purpose: In-order copy of the keys of subtree n within [lo, hi], skipping subtrees outside the range. */
+static size_t range_copy(const rbtree *t, const node_t *n, const key_t lo, const key_t hi, key_t *arr, const size_t nslots, size_t idx)
+{
+  while (n != t->nil && idx < nslots) // loop on the right, recurse on the left
   {
-    x = z->right;               // right child will replace z
-    transplant(t, z, z->right); // replace z with its right child
+    if (n->key < lo)    // n and its left subtree are below the range
+    {
+      n = n->right; // only the right side can hold keys >= lo
+      continue;     // keep descending
+    }
+    idx = range_copy(t, n->left, lo, hi, arr, nslots, idx);  // smaller keys first
+    if (n->key > hi || idx >= nslots)                        // past the range or out of room
+      break;                                                 // right subtree is even larger
+    for (size_t c = node_dup(n); c > 0 && idx < nslots; c--) // n is in range: every copy, while room is left
+      arr[idx++] = n->key;                                   // store key
+    n = n->right;                                            // continue with larger keys
   }
-  else if (z->right == t->nil) // if right child is nil
+  return idx; // next free slot
+}
+
+/* Purpose: Copy keys k with lo <= k <= hi in order, up to n of them, in O(log n + k); returns how many were copied. */
+size_t rbtree_range_to_array(const rbtree *t, const key_t lo, const key_t hi, key_t *arr, const size_t n)
+{
+  if (t == NULL || arr == NULL || n == 0 || hi < lo) // validate args
+    return 0;                                        // nothing copied
+  return range_copy(t, t->root, lo, hi, arr, n, 0);  // fill array
+}
+
+/* Purpose: Depth that gets red nodes when n sorted keys are split at the middle (-1 if none). */
+static int sorted_red_depth(const size_t n)
+{
+  if ((n & (n + 1)) == 0) // n = 2^k - 1: perfect tree, all black
+    return -1;            // no red level
+  int depth = 0;          // floor(log2(n)) is the depth of the bottom level
+  for (size_t m = n; m > 1; m >>= 1)
+    depth++;    // one more level
+  return depth; // incomplete bottom level is colored red
+}
+
+/* Purpose: Build a balanced subtree from keys[0..n) in order, so a slab lays the nodes out contiguously. */
+static node_t *build_sorted(rbtree *t, const key_t *keys, const size_t n, node_t *parent, const int depth, const int red_depth)
+{
+  if (n == 0)      // empty range
+    return t->nil; // leaf is the sentinel
+
+  const size_t mid = (n - 1) / 2; // left half gets the smaller share
+  node_t *left = build_sorted(t, keys, mid, NULL, depth + 1, red_depth); // left half first (in-order allocation)
+  if (left == NULL)                                                       // out of memory below
+    return NULL;                                                          // caller tears the tree down
+  node_t *z = node_alloc(t); // then this node
+  if (z == NULL)             // out of memory
+    return NULL;             // caller tears the tree down
+  node_t *right = build_sorted(t, keys + mid + 1, n - mid - 1, z, depth + 1, red_depth); // then right half
+  if (right == NULL)                                                                     // out of memory below
+    return NULL;                                                                         // caller tears the tree down
+
+  z->key = keys[mid];                                                  // middle key
+#ifdef RBTREE_MAP
+  memset(&z->value, 0, sizeof(z->value)); // no payload yet
+#endif
+#ifdef RBTREE_COUNTED
+  z->dup = 1; // from_sorted_runs sets run lengths afterwards
+#endif
+  rbtree_set_parent(z, parent);            // link up
+  z->left = left;                          // link left half
+  z->right = right;                        // link right half
+  set_sorted_balance(z, depth, red_depth); // color from depth, or rank from the children
+  augment_node(t, z);                      // children are complete
+  if (left != t->nil)                      // real left child
+    rbtree_set_parent(left, z);            // was built before z existed
+  return z;                                // subtree root
+}
+
+/* Purpose: Build a valid red-black tree from n keys in non-decreasing order in O(n), one node per key. */
+static rbtree *build_from_sorted(const key_t *keys, const size_t n)
+{
+  rbtree *t = new_rbtree_with_capacity(n); // one chunk holds every node
+  if (t == NULL || n == 0)                 // nothing to build
+    return t;                              // empty tree (or failure)
+  if (keys == NULL)                        // invalid input
+  {
+    delete_rbtree(t); // drop the empty tree
+    return NULL;      // report failure
+  }
+
+  node_t *root = build_sorted(t, keys, n, t->nil, 0, sorted_red_depth(n)); // link everything
+  if (root == NULL)                                                         // out of memory
+  {
+    delete_rbtree(t); // release what was built
+    return NULL;      // report failure
+  }
+  t->root = root;                // attach
+#ifdef RBTREE_LLRB
+  lean_subtree(t, root);                   // the red bottom level may lean right
+  rbtree_set_color(t->root, RBTREE_BLACK); // balancing may have split a 4-node at the top
+#endif
+  t->min = subtree_min(t, t->root); // leftmost node
+  t->max = subtree_max(t, t->root); // rightmost node
+  t->count = n;                     // every key was linked
+  return t;                         // root is black: depth 0 is never the red level of a non-perfect tree
+}
+
+#ifdef RBTREE_COUNTED
+#if defined(RBTREE_ORDER_STAT) || defined(RBTREE_AUGMENT_UPDATE)
+/* Purpose: Recompute augmented fields of every node of subtree n, children first. */
+static void augment_subtree(const rbtree *t, node_t *n)
+{
+  if (n == t->nil)              // nothing below a leaf
+    return;                     // sentinel keeps zeroed fields
+  augment_subtree(t, n->left);  // left subtree first
+  augment_subtree(t, n->right); // then right subtree
+  augment_node(t, n);           // then n from both
+}
+#endif
+
+/* Purpose: Counted build: one node per run of equal keys, holding the run length. */
+static rbtree *from_sorted_runs(const key_t *keys, const size_t n)
+{
+  key_t *uniq = (key_t *)malloc(n * sizeof(key_t)); // first key of every run
+  if (uniq == NULL)                                 // out of memory
+    return NULL;                                    // report failure
+  size_t u = 0;                                     // distinct keys so far
+  for (size_t i = 0; i < n; i++)
+    if (u == 0 || uniq[u - 1] != keys[i]) // a new run starts
+      uniq[u++] = keys[i];                // keep its key
+  rbtree *t = build_from_sorted(uniq, u); // one node per run
+  free(uniq);                             // drop scratch
+  if (t == NULL)                          // out of memory
+    return NULL;                          // report failure
+
+  size_t i = 0; // next key of the input
+  for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)) // nodes in key order, one per run
+  {
+    const size_t start = i;            // p's run starts here
+    while (i < n && keys[i] == p->key) // walk the run
+      i++;                             // one more copy
+    p->dup = i - start;                // run length
+  }
+#if defined(RBTREE_ORDER_STAT) || defined(RBTREE_AUGMENT_UPDATE)
+  augment_subtree(t, t->root); // sizes were computed with one copy per node
+#endif
+  t->count = n; // every copy was counted
+  return t;     // done
+}
+#endif
+
+/* Purpose: Build a valid red-black tree from n keys in non-decreasing order in O(n). */
+rbtree *rbtree_from_sorted_array(const key_t *keys, const size_t n)
+{
+#ifdef RBTREE_COUNTED
+  if (keys != NULL && n > 0)         // equal keys share a node
+    return from_sorted_runs(keys, n); // compress runs first
+#endif
+  return build_from_sorted(keys, n); // one node per key
+}
+
+#ifndef RBTREE_BATCH_REBUILD_RATIO
+#define RBTREE_BATCH_REBUILD_RATIO 4 // rebuild when batch * ratio >= tree size
+#endif
+
+/* Purpose: LSD radix sort of signed integer keys (8 bits per pass); tmp must hold m keys. */
+static void sort_keys(key_t *keys, key_t *tmp, const size_t m)
+{
+  for (size_t shift = 0; shift < 8 * sizeof(key_t); shift += 8) // one pass per byte, least significant first
+  {
+    const unsigned flip = shift + 8 == 8 * sizeof(key_t) ? 0x80 : 0; // flipping the sign bit orders negatives first
+    size_t pos[256] = {0};                                            // bucket counts, then start offsets
+    for (size_t i = 0; i < m; i++)
+      pos[(((unsigned long long)keys[i] >> shift) & 0xff) ^ flip]++; // count bucket sizes
+    if (pos[(((unsigned long long)keys[0] >> shift) & 0xff) ^ flip] == m) // every key shares this byte
+      continue;                                                          // pass would not move anything
+    size_t sum = 0; // prefix sum
+    for (int b = 0; b < 256; b++)
+    {
+      const size_t c = pos[b]; // bucket size
+      pos[b] = sum;            // bucket start
+      sum += c;                // next start
+    }
+    for (size_t i = 0; i < m; i++)
+      tmp[pos[(((unsigned long long)keys[i] >> shift) & 0xff) ^ flip]++] = keys[i]; // stable scatter
+    memcpy(keys, tmp, m * sizeof(key_t)); // result back in keys for the next pass
+  }
+}
+
+/* Purpose: Collect the nodes of subtree n in key order into out; returns the next free slot. */
+static size_t collect_nodes(const rbtree *t, node_t *n, node_t **out, size_t idx)
+{
+  while (n != t->nil) // loop on the right spine, recurse on the left
+  {
+    idx = collect_nodes(t, n->left, out, idx); // left subtree first
+    out[idx++] = n;                            // then this node
+    n = n->right;                              // then right subtree
+  }
+  return idx; // next free slot
+}
+
+/* Purpose: Relink nodes[0..n) (in key order) into a balanced subtree, coloring by depth like build_sorted. */
+static node_t *link_sorted(rbtree *t, node_t **nodes, const size_t n, node_t *parent, const int depth, const int red_depth)
+{
+  if (n == 0)      // empty range
+    return t->nil; // leaf is the sentinel
+
+  const size_t mid = (n - 1) / 2;                                                   // same split as build_sorted
+  node_t *z = nodes[mid];                                                           // middle node becomes subtree root
+  rbtree_set_parent(z, parent);                                                     // link up
+  z->left = link_sorted(t, nodes, mid, z, depth + 1, red_depth);                    // left half
+  z->right = link_sorted(t, nodes + mid + 1, n - mid - 1, z, depth + 1, red_depth); // right half
+  set_sorted_balance(z, depth, red_depth);                                          // color from depth, or rank from the children
+  augment_node(t, z);                                                               // children are complete
+  return z;                                                                         // subtree root
+}
+
+/* Purpose: Merge sorted keys into the tree by relinking every node in one O(n + m) pass. */
+static size_t merge_rebuild(rbtree *t, const key_t *keys, const size_t m)
+{
+  const size_t n = t->count;                                    // nodes already in the tree
+  node_t **all = (node_t **)malloc((n + m) * sizeof(node_t *)); // merged order
+  node_t **fresh = (node_t **)malloc(m * sizeof(node_t *));     // one new node per batch key
+  if (all == NULL || fresh == NULL)                             // out of memory
+  {
+    free(all);   // free(NULL) is fine
+    free(fresh); // free(NULL) is fine
+    return 0;    // tree untouched
+  }
+  for (size_t j = 0; j < m; j++) // allocate before touching the tree
+  {
+    fresh[j] = new_node(t, keys[j]); // node for the batch key
+    if (fresh[j] == NULL)            // out of memory
+    {
+      while (j > 0)                // give back what was taken
+        node_free(t, fresh[--j]);  // recycle
+      free(all);                   // drop scratch
+      free(fresh);                 // drop scratch
+      return 0;                    // tree untouched
+    }
+  }
+
+  node_t **old = all + m;                                 // existing nodes go to the tail; the merge never overtakes them
+  const size_t nodes = collect_nodes(t, t->root, old, 0); // existing nodes keep their identity (n of them unless counted)
+  size_t i = 0, j = 0, k = 0;                             // cursors into old, fresh and all
+  while (i < nodes || j < m)                              // classic two-way merge
+  {
+    if (j == m || (i < nodes && old[i]->key <= fresh[j]->key)) // equal existing keys first: duplicates go right
+      all[k++] = old[i++];                                     // reuse existing node
+#ifdef RBTREE_COUNTED
+    else if (k > 0 && all[k - 1]->key == fresh[j]->key) // key already placed
+    {
+      all[k - 1]->dup++;        // count the copy there
+      node_free(t, fresh[j++]); // its own node is not needed
+    }
+#endif
+    else
+      all[k++] = fresh[j++]; // new node
+  }
+
+  t->root = link_sorted(t, all, k, t->nil, 0, sorted_red_depth(k)); // relink everything
+#ifdef RBTREE_LLRB
+  lean_subtree(t, t->root);                // the red bottom level may lean right
+  rbtree_set_color(t->root, RBTREE_BLACK); // balancing may have split a 4-node at the top
+#endif
+  t->min = all[0];                                                  // smallest of old and new
+  t->max = all[k - 1];                                              // largest of old and new
+  t->count = n + m;                                                 // batch is in
+  t->hint = NULL;                                                   // new keys may sit between the hint and its successor
+  free(all);                                                                // drop scratch
+  free(fresh);                                                              // drop scratch
+  return m;                                                                 // every key inserted
+}
+
+/* Purpose: Insert m keys at once: sort them, then relink the whole tree or descend in key order; returns the count inserted. */
+size_t rbtree_insert_batch(rbtree *t, const key_t *keys, const size_t m)
+{
+  if (t == NULL || keys == NULL || m == 0) // validate args
+    return 0;                              // nothing inserted
+
+  key_t *sorted = (key_t *)malloc(2 * m * sizeof(key_t)); // caller's keys stay untouched; second half is scratch
+  if (sorted == NULL)                                     // out of memory
+    return 0;                                             // nothing inserted
+  memcpy(sorted, keys, m * sizeof(key_t));                // copy batch
+  sort_keys(sorted, sorted + m, m);                       // ascending order in O(m)
+
+  size_t inserted = 0;                             // keys linked so far
+  if (m * RBTREE_BATCH_REBUILD_RATIO >= t->count)  // batch is large relative to the tree
+    inserted = merge_rebuild(t, sorted, m);        // one linear relink
+  if (inserted == 0)                               // small batch (or no memory for the rebuild)
+  {
+    for (; inserted < m; inserted++) // ascending keys share most of their root path, so it stays in cache
+    {
+      if (rbtree_insert(t, sorted[inserted]) == NULL) // out of memory
+        break;                                        // report what made it in
+    }
+  }
+  free(sorted); // drop scratch
+  return inserted; // every key unless memory ran out
+}
+
+#ifdef RBTREE_ORDER_STAT
+/* Purpose: Return the node holding the k-th smallest key (k counts from 0), or NULL if k >= count. */
+node_t *rbtree_select(const rbtree *t, size_t k)
+{
+  if (t == NULL || k >= t->root->size) // out of range
+    return NULL;                       // no such key
+  node_t *curr = t->root;              // start from root
+  while (curr != t->nil)
   {
-    x = z->left;               // left child will replace z
-    transplant(t, z, z->left); // replace z with its left child
+    const size_t left = curr->left->size; // keys smaller than curr in this subtree
+    if (k < left)                         // k-th lies left
+      curr = curr->left;                  // move left
+    else if (k - left < node_dup(curr))   // curr (or one of its copies) is the k-th
+      return curr;                        // found
+    else
+    {
+      k -= left + node_dup(curr); // skip left subtree and curr
+      curr = curr->right;         // move right
+    }
   }
-  else // both children exist
+  return NULL; // unreachable while sizes are consistent
+}
+
+/* Purpose: Count keys below key (or up to and including key when `inclusive`) in O(log n). */
+static size_t count_below(const rbtree *t, const key_t key, const int inclusive)
+{
+  size_t below = 0;       // keys known to be smaller
+  node_t *curr = t->root; // start from root
+  while (curr != t->nil)
   {
-    y = subtree_min(t, z->right); // successor is minimum in right subtree
-    y_original_color = y->color;  // save successor color
-    x = y->right;                 // x is successor's right child
-    if (y->parent == z)           // if successor is direct child
+    if (curr->key < key || (inclusive && curr->key == key)) // curr and its left subtree count
     {
-      x->parent = y; // set x's parent to successor (may set nil->parent)
+      below += curr->left->size + node_dup(curr); // take them
+      curr = curr->right;            // look for more on the right
     }
     else
+      curr = curr->left; // everything from curr on is too large
+  }
+  return below; // total
+}
+
+/* Purpose: Return the number of keys strictly smaller than key, i.e. the index key has or would get. */
+size_t rbtree_rank(const rbtree *t, const key_t key)
+{
+  if (t == NULL)                 // invalid input
+    return 0;                    // empty
+  return count_below(t, key, 0); // strict count
+}
+
+/* Purpose: Return the number of keys k with lo <= k <= hi. */
+size_t rbtree_count_range(const rbtree *t, const key_t lo, const key_t hi)
+{
+  if (t == NULL || hi < lo) // invalid input or empty range
+    return 0;               // nothing in range
+  return count_below(t, hi, 1) - count_below(t, lo, 0); // keys <= hi minus keys < lo
+}
+#endif
+
+#ifdef RBTREE_INTERVAL
+/* Purpose: Insert the half-open interval [start, end), keyed by start, and return its node. */
+node_t *rbtree_interval_insert(rbtree *t, const key_t start, const key_t end)
+{
+  node_t *z = new_node(t, start); // allocate new node
+  if (z == NULL)                  // out of memory
+    return NULL;                  // nothing inserted
+  z->end = end;                   // set before the path summaries are recomputed
+  insert_below(t, z);             // usual descent and fixup
+  return z;                       // return new node
+}
+
+/* Purpose: Whether node n's interval overlaps [lo, hi); an empty interval or query overlaps nothing. */
+static int interval_overlaps(const node_t *n, const key_t lo, const key_t hi)
+{
+  return lo < hi && n->key < n->end && n->key < hi && lo < n->end; // both non-empty, half-open on both sides
+}
+
+/* Purpose: Return the overlapping interval with the smallest start, or NULL, in O(log n). */
+node_t *rbtree_interval_overlap_first(const rbtree *t, const key_t lo, const key_t hi)
+{
+  if (t == NULL) // invalid input
+    return NULL; // nothing found
+  node_t *curr = t->root; // start from root
+  while (curr != t->nil)
+  {
+    if (curr->left != t->nil && curr->left->max_end > lo) // something on the left ends after lo:
     {
-      transplant(t, y, y->right); // replace successor with its right child
-      y->right = z->right;        // move z's right subtree under y
-      y->right->parent = y;       // fix parent
+      curr = curr->left; // the answer is there or nowhere (anything to its right starts even later)
+      continue;          // keep descending
     }
-    transplant(t, z, y); // replace z with successor
-    y->left = z->left;   // attach z's left subtree to y
-    y->left->parent = y; // fix parent
-    y->color = z->color; // copy color
+    if (interval_overlaps(curr, lo, hi)) // nothing on the left: curr is next in start order
+      return curr;                       // found
+    if (curr->key >= hi)                 // curr and everything right of it start too late
+      return NULL;                       // no overlap
+    curr = curr->right;                  // try later starts
   }
+  return NULL; // not found
+}
 
-  if (y_original_color == RBTREE_BLACK) // if removed node was black
+/* Purpose: In-order walk of subtree n that skips subtrees ending by lo and starts from hi on; returns 0 once visit asks to stop. */
+static int overlap_walk(const rbtree *t, node_t *n, const key_t lo, const key_t hi, int (*visit)(node_t *, void *), void *ctx, size_t *found)
+{
+  while (n != t->nil && n->max_end > lo) // nothing below n ends after lo otherwise
   {
-    rebuild_after_delete(t, x); // restore red-black properties
+    if (!overlap_walk(t, n->left, lo, hi, visit, ctx, found)) // smaller starts first
+      return 0;                                               // stopped below
+    if (n->key >= hi)                                         // n and its right subtree start too late
+      return 1;                                               // done with this subtree
+    if (interval_overlaps(n, lo, hi))                         // report n
+    {
+      (*found)++;         // one more match
+      if (!visit(n, ctx)) // caller has enough
+        return 0;         // stop everything
+    }
+    n = n->right; // continue with later starts
   }
+  return 1; // subtree done
+}
 
-  free(z);  // free removed node
-  return 1; // success
+/* Purpose: Stream every interval overlapping [lo, hi) to visit in start order; visit returns 0 to stop. Returns the number visited. */
+size_t rbtree_interval_overlap_all(const rbtree *t, const key_t lo, const key_t hi, int (*visit)(node_t *, void *), void *ctx)
+{
+  size_t found = 0;                                     // intervals reported
+  if (t == NULL || visit == NULL)                       // invalid input
+    return 0;                                           // nothing reported
+  overlap_walk(t, t->root, lo, hi, visit, ctx, &found); // pruned walk
+  return found;                                         // report count
 }
+#endif
 
-/* Purpose: In-order traversal copying up to n keys into arr. */
-static int in_order_copy(const rbtree *t, node_t *n, key_t *arr, const size_t nslots, int idx)
+#ifdef RBTREE_MAP
+/* Purpose: Set key's value, inserting the key if absent, in a single descent; returns its node (NULL if out of memory). */
+node_t *rbtree_upsert(rbtree *t, const key_t key, const value_t value)
 {
-  if (n == t->nil || idx >= (int)nslots)              // stop if nil or array full
-    return idx;                                       // return current index
-  idx = in_order_copy(t, n->left, arr, nslots, idx);  // traverse left
-  if (idx < (int)nslots)                              // if room left
-    arr[idx] = n->key;                                // store key
-  idx++;                                              // increment index
-  idx = in_order_copy(t, n->right, arr, nslots, idx); // traverse right
-  return idx;                                         // return updated index
+  if (t == NULL) // invalid input
+    return NULL; // nothing stored
+  node_t *y, *prev, *next;
+  node_t *n = find_slot(t, key, &y, &prev, &next); // one walk from the root
+  if (n != NULL)                                   // key already present
+  {
+    n->value = value;   // update in place
+    augment_path(t, n); // user summaries may read the value
+    return n;           // no allocation, no rebalancing
+  }
+  n = new_node(t, key);             // allocate new node
+  if (n == NULL)                    // out of memory
+    return NULL;                    // nothing inserted
+  n->value = value;                 // set before the path summaries are recomputed
+  attach_leaf(t, n, y, prev, next); // hang it where the descent ended
+  return n;                         // return new node
 }
 
-int rbtree_to_array(const rbtree *t, key_t *arr, const size_t n)
+/* Purpose: Return key's node, inserting it with a zeroed value if absent; *inserted (if not NULL) says which happened. */
+node_t *rbtree_get_or_insert(rbtree *t, const key_t key, int *inserted)
 {
-  if (t == NULL || arr == NULL || n == 0) // validate args
-    return 0;                             // nothing copied
-  in_order_copy(t, t->root, arr, n, 0);   // fill array
-  return 0;                               // API returns int; keep 0
+  if (inserted != NULL) // report nothing inserted unless it is
+    *inserted = 0;      // default
+  if (t == NULL)        // invalid input
+    return NULL;        // nothing found
+  node_t *y, *prev, *next;
+  node_t *n = find_slot(t, key, &y, &prev, &next); // one walk from the root
+  if (n != NULL)                                   // key already present
+    return n;                                      // caller reads or edits the value
+  n = new_node(t, key);                            // allocate new node
+  if (n == NULL)                                   // out of memory
+    return NULL;                                   // nothing inserted
+  attach_leaf(t, n, y, prev, next);                // hang it where the descent ended
+  if (inserted != NULL)                            // caller wants to know
+    *inserted = 1;                                 // new key
+  return n;                                        // return new node
 }
+#endif
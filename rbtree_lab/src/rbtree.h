@@ -2,6 +2,7 @@
 #define _RBTREE_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef enum
 {
@@ -11,28 +12,174 @@ typedef enum
 
 typedef int key_t;
 
+// Augmentation: build with -DRBTREE_AUGMENT='"file.h"' where file.h defines
+//   RBTREE_AUGMENT_FIELDS          extra node_t members, e.g. `long sum;`
+//   RBTREE_AUGMENT_UPDATE(t, n)    recompute n's members from n->left/n->right
+// The update runs only on nodes whose subtree changed; the sentinel t->nil keeps zeroed members.
+#ifdef RBTREE_AUGMENT
+#include RBTREE_AUGMENT
+#endif
+
+// Map mode: build with -DRBTREE_MAP to give every node an inline payload `value`, a void * unless
+// -DRBTREE_VALUE_TYPE=... names another type. rbtree_upsert and rbtree_get_or_insert treat keys as unique.
+#ifdef RBTREE_MAP
+#ifndef RBTREE_VALUE_TYPE
+#define RBTREE_VALUE_TYPE void *
+#endif
+typedef RBTREE_VALUE_TYPE value_t;
+#endif
+
+// Counted multiset: build with -DRBTREE_COUNTED to keep one node per distinct key with a multiplicity
+// `dup`. rbtree_insert of a present key bumps dup, rbtree_erase drops one copy, t->count counts copies and
+// the array and order-statistic calls expand them. Intervals with one start still need their own nodes.
+#if defined(RBTREE_COUNTED) && defined(RBTREE_INTERVAL)
+#error "RBTREE_COUNTED cannot be combined with RBTREE_INTERVAL"
+#endif
+
+// Balancing backend: CLRS red-black by default. Build with -DRBTREE_AVL (height-balanced, shallower trees for
+// read-heavy use), -DRBTREE_WAVL (weak AVL: AVL's shape after inserts, at most two rotations per erase) or
+// -DRBTREE_LLRB (left-leaning red-black, Sedgewick's 2-3 variant). Every function below behaves the same;
+// AVL and WAVL nodes keep an int rank in place of the color, so they cannot use the compact layout.
+#if defined(RBTREE_AVL) + defined(RBTREE_WAVL) + defined(RBTREE_LLRB) > 1
+#error "choose at most one of RBTREE_AVL, RBTREE_WAVL and RBTREE_LLRB"
+#endif
+#if defined(RBTREE_AVL) || defined(RBTREE_WAVL)
+#define RBTREE_RANKED
+#ifdef RBTREE_COMPACT
+#error "RBTREE_COMPACT keeps a color bit; AVL and WAVL nodes need a rank"
+#endif
+#endif
+
+// Compact layout: build with -DRBTREE_COMPACT to keep the color in bit 0 of the parent link.
+// With int keys color and key already share a word, so a plain node is 32 bytes either way; compact
+// nodes are also 32-byte aligned so none straddles a cache line, and a wider key_t would still fit.
+// Augmented, map and counted nodes are not aligned, since rounding them up to 64 bytes would cost more than it saves.
+// Code outside rbtree.c reads color and parent through the accessors below in either layout.
+#if defined(RBTREE_COMPACT) && !defined(RBTREE_ORDER_STAT) && !defined(RBTREE_INTERVAL) && !defined(RBTREE_AUGMENT_FIELDS) && \
+    !defined(RBTREE_MAP) && !defined(RBTREE_COUNTED)
+#define RBTREE_NODE_ALIGN __attribute__((aligned(32)))
+#else
+#define RBTREE_NODE_ALIGN
+#endif
+
 typedef struct node_t
 {
+#ifdef RBTREE_COMPACT
+  uintptr_t parent_color; // parent pointer | color (RBTREE_RED is 0, RBTREE_BLACK is 1)
+  key_t key;
+#else
+#ifdef RBTREE_RANKED
+  int rank; // AVL: height of the subtree rooted here, WAVL: its rank; -1 for the sentinel
+#else
   color_t color;
+#endif
   key_t key;
-  struct node_t *parent, *left, *right;
-} node_t;
+  struct node_t *parent;
+#endif
+  struct node_t *left, *right;
+#ifdef RBTREE_MAP
+  value_t value; // zeroed for nodes not created by rbtree_upsert
+#endif
+#ifdef RBTREE_COUNTED
+  size_t dup; // copies of key held by this node (1 for caller-owned nodes, which are never merged)
+#endif
+#ifdef RBTREE_ORDER_STAT
+  size_t size; // keys in the subtree rooted here, counted copies included (0 for the sentinel)
+#endif
+#ifdef RBTREE_INTERVAL
+  key_t end;     // interval is [key, end), empty (overlapping nothing) when end <= key
+  key_t max_end; // largest end of a non-empty interval in the subtree rooted here
+#endif
+#ifdef RBTREE_AUGMENT_FIELDS
+  RBTREE_AUGMENT_FIELDS
+#endif
+} RBTREE_NODE_ALIGN node_t;
+
+#ifdef RBTREE_COMPACT
+#define rbtree_parent(n) ((node_t *)((n)->parent_color & ~(uintptr_t)1))
+#define rbtree_color(n) ((color_t)((n)->parent_color & 1))
+#define rbtree_set_parent(n, p) ((n)->parent_color = (uintptr_t)(p) | ((n)->parent_color & 1))
+#define rbtree_set_color(n, c) ((n)->parent_color = ((n)->parent_color & ~(uintptr_t)1) | (uintptr_t)(c))
+#else
+#define rbtree_parent(n) ((n)->parent)
+#define rbtree_color(n) ((n)->color)
+#define rbtree_set_parent(n, p) ((n)->parent = (p))
+#define rbtree_set_color(n, c) ((n)->color = (c))
+#endif
+
+// Intrusive use: embed a node_t in your own struct, set its key (and end, in interval builds), then
+// rbtree_insert_node links it and rbtree_remove_node unlinks it; neither allocates or frees.
+// rbtree_entry(p, type, member) gets the enclosing struct back from a node pointer. Unlink such nodes
+// with rbtree_remove_node, never rbtree_erase, and before delete_rbtree/rbtree_clear in
+// RBTREE_CALLOC_NODES builds, which free() every node still linked.
+#define rbtree_entry(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+struct rbtree_slab_chunk; // slab chunk nodes are carved from (see rbtree_slab.h)
+
+typedef struct
+{
+  struct rbtree_slab_chunk *chunks; // every chunk owned by this tree, newest first
+  void *free_list;                  // recycled nodes, linked through a child pointer
+  size_t chunk_left;                // nodes not yet carved out of the newest chunk
+} rbtree_slab;
 
 typedef struct
 {
   node_t *root;
   node_t *nil; // for sentinel
+  size_t count; // number of keys stored
+  node_t *min;  // leftmost node, nil when empty (rbtree_min is O(1))
+  node_t *max;  // rightmost node, nil when empty
+  node_t *hint;      // last node linked by an insert (NULL after erasing it or a neighbour)
+  node_t *hint_prev; // hint's in-order predecessor, NULL if hint is the min
+  node_t *hint_next; // hint's in-order successor, NULL if hint is the max
+
+  rbtree_slab slab; // per-tree node allocator (unused when built with -DRBTREE_CALLOC_NODES)
+#ifdef RBTREE_STATS
+  size_t rotations; // rotations performed so far, for comparing balancing backends
+#endif
 } rbtree;
 
 rbtree *new_rbtree(void);
+rbtree *new_rbtree_with_capacity(const size_t);
 void delete_rbtree(rbtree *);
+void rbtree_clear(rbtree *);
+rbtree *rbtree_from_sorted_array(const key_t *, const size_t);
 
 node_t *rbtree_insert(rbtree *, const key_t);
+node_t *rbtree_insert_hint(rbtree *, const key_t, node_t *);
+size_t rbtree_insert_batch(rbtree *, const key_t *, const size_t);
+node_t *rbtree_insert_node(rbtree *, node_t *);
 node_t *rbtree_find(const rbtree *, const key_t);
 node_t *rbtree_min(const rbtree *);
 node_t *rbtree_max(const rbtree *);
+node_t *rbtree_lower_bound(const rbtree *, const key_t);
+node_t *rbtree_upper_bound(const rbtree *, const key_t);
+node_t *rbtree_next(const rbtree *, const node_t *);
+node_t *rbtree_prev(const rbtree *, const node_t *);
 int rbtree_erase(rbtree *, node_t *);
+int rbtree_remove_node(rbtree *, node_t *);
+int rbtree_pop_min(rbtree *, key_t *);
+int rbtree_pop_max(rbtree *, key_t *);
 
 int rbtree_to_array(const rbtree *, key_t *, const size_t);
+size_t rbtree_range_to_array(const rbtree *, const key_t, const key_t, key_t *, const size_t);
+
+#ifdef RBTREE_ORDER_STAT
+node_t *rbtree_select(const rbtree *, size_t);
+size_t rbtree_rank(const rbtree *, const key_t);
+size_t rbtree_count_range(const rbtree *, const key_t, const key_t);
+#endif
+
+#ifdef RBTREE_MAP
+node_t *rbtree_upsert(rbtree *, const key_t, const value_t);
+node_t *rbtree_get_or_insert(rbtree *, const key_t, int *);
+#endif
+
+#ifdef RBTREE_INTERVAL
+node_t *rbtree_interval_insert(rbtree *, const key_t, const key_t);
+node_t *rbtree_interval_overlap_first(const rbtree *, const key_t, const key_t);
+size_t rbtree_interval_overlap_all(const rbtree *, const key_t, const key_t, int (*)(node_t *, void *), void *);
+#endif
 
 #endif // _RBTREE_H_
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "rbtree_btree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LEAF_MIN ((int)RBTREE_BT_LEAF_KEYS / 2)         // fill every non-root leaf keeps
+#define INNER_MIN (((int)RBTREE_BT_INNER_KEYS - 1) / 2) // the middle separator of a split goes up
+
+// Node-local search counts keys over the node's whole key array, masking slots past n: a loop with a
+// constant trip count and no branch on the keys is what compilers vectorize at -O2.
+#define rank_below(keys, n, cap, key) rank_in((keys), (n), (cap), (key), 0) // index of the first key >= key
+#define rank_upto(keys, n, cap, key) rank_in((keys), (n), (cap), (key), 1)  // index of the first key > key
+
+/* Purpose: Count the keys among keys[0..n) below key (or not above it, when upto); cap is the array's constant size. */
+static inline int rank_in(const key_t *keys, const int n, const int cap, const key_t key, const int upto)
+{
+  int r = 0;                                                      // qualifying keys so far
+  for (int i = 0; i < cap; i++)                                   // whole array: it is only a few cache lines
+    r += ((keys[i] < key) | (upto & (keys[i] == key))) & (i < n); // 0 or 1; stale slots count 0
+  return r;                                                       // keys are sorted: this is an index
+}
+
+/* Purpose: Allocate one zeroed, cache-line-aligned node, so the search never reads uninitialized slots. */
+static void *node_alloc(void)
+{
+  void *n = aligned_alloc(64, RBTREE_BT_NODE_BYTES); // whole cache lines
+  if (n != NULL)                                     // out of memory otherwise
+    memset(n, 0, RBTREE_BT_NODE_BYTES);              // slots past n are searched, then masked
+  return n;                                          // NULL on failure
+}
+
+/* Purpose: Create an empty tree; its first leaf is allocated by the first insert. */
+rbtree_bt *new_rbtree_bt(void)
+{
+  return (rbtree_bt *)calloc(1, sizeof(rbtree_bt)); // NULL root, no leaves
+}
+
+/* Purpose: Free subtree n, whose root is `level` levels above the leaves. */
+static void free_subtree(void *n, const int level)
+{
+  if (level > 0) // inner node: children first
+  {
+    btinner_t *in = (btinner_t *)n;          // inner view
+    for (int i = 0; i <= in->n; i++)         // every child
+      free_subtree(in->child[i], level - 1); // one level down
+  }
+  free(n); // then the node
+}
+
+/* Purpose: Free every node and the tree. */
+void delete_rbtree_bt(rbtree_bt *t)
+{
+  if (t == NULL)                      // nothing to do if tree is NULL
+    return;                           // early return
+  if (t->root != NULL)                // tree is not empty
+    free_subtree(t->root, t->height); // drop all nodes
+  free(t);                            // free tree struct
+}
+
+/* Purpose: Split in's full child i (level `level`) in two and put their separator into in at i; returns 0 when out of memory. */
+static int split_child(btinner_t *in, const int i, const int level)
+{
+  key_t sep;                  // separator moved into in
+  void *right = node_alloc(); // upper half goes here
+  if (right == NULL)          // out of memory
+    return 0;                 // tree untouched
+  if (level == 0)             // leaf: keys stay in the leaves
+  {
+    btleaf_t *l = (btleaf_t *)in->child[i];               // full leaf
+    btleaf_t *r = (btleaf_t *)right;                      // new right sibling
+    const int mid = l->n / 2;                             // lower half stays
+    r->n = l->n - mid;                                    // upper half moves
+    memcpy(r->keys, l->keys + mid, r->n * sizeof(key_t)); // copy it
+    l->n = mid;                                           // shrink
+    r->next = l->next;                                    // chain r after l
+    l->next = r;                                          // chain r after l
+    sep = r->keys[0];                                     // no key of l is larger, no key of r smaller
+  }
+  else // inner node: the middle separator moves up
+  {
+    btinner_t *l = (btinner_t *)in->child[i];                          // full inner node
+    btinner_t *r = (btinner_t *)right;                                 // new right sibling
+    const int mid = l->n / 2;                                          // separator that moves up
+    r->n = l->n - mid - 1;                                             // separators right of it
+    memcpy(r->keys, l->keys + mid + 1, r->n * sizeof(key_t));          // move them
+    memcpy(r->child, l->child + mid + 1, (r->n + 1) * sizeof(void *)); // with their children
+    sep = l->keys[mid];                                                // goes up to in
+    l->n = mid;                                                        // shrink
+  }
+  memmove(in->keys + i + 1, in->keys + i, (in->n - i) * sizeof(key_t));        // open a slot for sep
+  memmove(in->child + i + 2, in->child + i + 1, (in->n - i) * sizeof(void *)); // and for right
+  in->keys[i] = sep;                                                           // separator
+  in->child[i + 1] = right;                                                    // right half follows it
+  in->n++;                                                                     // one more child
+  return 1;                                                                    // success
+}
+
+/* Purpose: Tell whether node n at `level` has no room left. */
+static int node_full(const void *n, const int level)
+{
+  if (level == 0)                                                // leaf
+    return ((const btleaf_t *)n)->n == (int)RBTREE_BT_LEAF_KEYS; // every key slot used
+  return ((const btinner_t *)n)->n == (int)RBTREE_BT_INNER_KEYS; // every separator slot used
+}
+
+/* Purpose: Insert a key in one pass from the root, splitting full nodes on the way down; returns 0 when out of memory. */
+int rbtree_bt_insert(rbtree_bt *t, const key_t key)
+{
+  if (t->root == NULL) // empty tree
+  {
+    btleaf_t *l = (btleaf_t *)node_alloc(); // first leaf
+    if (l == NULL)                          // out of memory
+      return 0;                             // nothing inserted
+    l->n = 0;                               // no keys yet
+    l->next = NULL;                         // only leaf
+    t->root = t->head = l;                  // it is the root and the first leaf
+    t->height = 0;                          // no inner levels
+  }
+  if (node_full(t->root, t->height)) // full root: the tree grows at the top
+  {
+    btinner_t *r = (btinner_t *)node_alloc(); // new root
+    if (r == NULL)                            // out of memory
+      return 0;                               // nothing inserted
+    r->n = 0;                                 // single child so far
+    r->child[0] = t->root;                    // old root below it
+    if (!split_child(r, 0, t->height))        // halve the old root
+    {
+      free(r);  // tree untouched
+      return 0; // nothing inserted
+    }
+    t->root = r; // attach
+    t->height++; // one level more
+  }
+
+  void *n = t->root;                              // never full: the child we enter is split first
+  for (int level = t->height; level > 0; level--) // down to the leaves
+  {
+    btinner_t *in = (btinner_t *)n;                                // inner view
+    int i = rank_upto(in->keys, in->n, RBTREE_BT_INNER_KEYS, key); // equal keys go right, after their copies
+    if (node_full(in->child[i], level - 1))                        // no room for a separator or key coming up
+    {
+      if (!split_child(in, i, level - 1)) // split it while in has room
+        return 0;                         // splits so far keep the tree valid
+      if (key >= in->keys[i])             // key belongs in the upper half
+        i++;                              // step over the new separator
+    }
+    n = in->child[i]; // one level down
+  }
+
+  btleaf_t *l = (btleaf_t *)n;                                       // leaf with room
+  const int i = rank_upto(l->keys, l->n, RBTREE_BT_LEAF_KEYS, key);  // after every copy of key
+  memmove(l->keys + i + 1, l->keys + i, (l->n - i) * sizeof(key_t)); // open a slot
+  l->keys[i] = key;                                                  // store key
+  l->n++;                                                            // one more key here
+  t->count++;                                                        // one more key
+  return 1;                                                          // success
+}
+
+/* Purpose: Return a pointer to the first key >= key (valid until the next insert or erase), or NULL if every key is smaller. */
+const key_t *rbtree_bt_lower_bound(const rbtree_bt *t, const key_t key)
+{
+  if (t == NULL || t->root == NULL) // empty tree
+    return NULL;                    // nothing qualifies
+  const void *n = t->root;          // start from root
+  for (int level = t->height; level > 0; level--)
+  {
+    const btinner_t *in = (const btinner_t *)n;                            // inner view
+    n = in->child[rank_below(in->keys, in->n, RBTREE_BT_INNER_KEYS, key)]; // earlier children only hold smaller keys
+  }
+  const btleaf_t *l = (const btleaf_t *)n;                           // leaf where the answer is, unless it is past the end
+  const int i = rank_below(l->keys, l->n, RBTREE_BT_LEAF_KEYS, key); // first key >= key in this leaf
+  if (i < l->n)                                                      // found here
+    return &l->keys[i];                                              // point into the leaf
+  return l->next != NULL ? &l->next->keys[0] : NULL;                 // else the smallest key of the next leaf
+}
+
+/* Purpose: Return a pointer to a copy of key (valid until the next insert or erase), or NULL. */
+const key_t *rbtree_bt_find(const rbtree_bt *t, const key_t key)
+{
+  const key_t *p = rbtree_bt_lower_bound(t, key); // first copy if present
+  return p != NULL && *p == key ? p : NULL;       // present only if equal
+}
+
+/* Purpose: Return a pointer to the smallest key, or NULL if the tree is empty. */
+const key_t *rbtree_bt_min(const rbtree_bt *t)
+{
+  return t->count > 0 ? &t->head->keys[0] : NULL; // first key of the first leaf
+}
+
+/* Purpose: Return a pointer to the largest key, or NULL if the tree is empty. */
+const key_t *rbtree_bt_max(const rbtree_bt *t)
+{
+  if (t->count == 0) // empty tree
+    return NULL;     // no keys
+  const void *n = t->root;
+  for (int level = t->height; level > 0; level--)                    // rightmost path
+    n = ((const btinner_t *)n)->child[((const btinner_t *)n)->n];    // last child
+  return &((const btleaf_t *)n)->keys[((const btleaf_t *)n)->n - 1]; // last key
+}
+
+/* Purpose: Refill in's leaf child i after it dropped below half: borrow a key from a sibling, or merge with one. */
+static void fix_leaf(btinner_t *in, const int i)
+{
+  btleaf_t *c = (btleaf_t *)in->child[i];                            // underfull leaf
+  btleaf_t *left = i > 0 ? (btleaf_t *)in->child[i - 1] : NULL;      // sibling before it
+  btleaf_t *right = i < in->n ? (btleaf_t *)in->child[i + 1] : NULL; // sibling after it
+  if (left != NULL && left->n > LEAF_MIN)                            // left can spare its largest key
+  {
+    memmove(c->keys + 1, c->keys, c->n * sizeof(key_t)); // open the first slot
+    c->keys[0] = left->keys[--left->n];                  // move it over
+    c->n++;                                              // one more here
+    in->keys[i - 1] = c->keys[0];                        // separator follows the boundary
+    return;                                              // done
+  }
+  if (right != NULL && right->n > LEAF_MIN) // right can spare its smallest key
+  {
+    c->keys[c->n++] = right->keys[0];                                  // move it over
+    memmove(right->keys, right->keys + 1, --right->n * sizeof(key_t)); // close the gap
+    in->keys[i] = right->keys[0];                                      // separator follows the boundary
+    return;                                                            // done
+  }
+  const int k = left != NULL ? i - 1 : i;                                          // merge child k + 1 into child k
+  btleaf_t *l = (btleaf_t *)in->child[k];                                          // survivor
+  btleaf_t *r = (btleaf_t *)in->child[k + 1];                                      // emptied
+  memcpy(l->keys + l->n, r->keys, r->n * sizeof(key_t));                           // both at half or less: they fit
+  l->n += r->n;                                                                    // take r's keys
+  l->next = r->next;                                                               // unchain r
+  memmove(in->keys + k, in->keys + k + 1, (in->n - k - 1) * sizeof(key_t));        // drop their separator
+  memmove(in->child + k + 1, in->child + k + 2, (in->n - k - 1) * sizeof(void *)); // and r
+  in->n--;                                                                         // one child less
+  free(r);                                                                         // release it
+}
+
+/* Purpose: Refill in's inner child i after it dropped below half: rotate a child through the separator, or merge. */
+static void fix_inner(btinner_t *in, const int i)
+{
+  btinner_t *c = (btinner_t *)in->child[i];                            // underfull node
+  btinner_t *left = i > 0 ? (btinner_t *)in->child[i - 1] : NULL;      // sibling before it
+  btinner_t *right = i < in->n ? (btinner_t *)in->child[i + 1] : NULL; // sibling after it
+  if (left != NULL && left->n > INNER_MIN)                             // left can spare its last child
+  {
+    memmove(c->keys + 1, c->keys, c->n * sizeof(key_t));          // open the first separator slot
+    memmove(c->child + 1, c->child, (c->n + 1) * sizeof(void *)); // and the first child slot
+    c->keys[0] = in->keys[i - 1];                                 // old separator comes down
+    c->child[0] = left->child[left->n];                           // left's last child moves over
+    in->keys[i - 1] = left->keys[--left->n];                      // left's last separator goes up
+    c->n++;                                                       // one more child here
+    return;                                                       // done
+  }
+  if (right != NULL && right->n > INNER_MIN) // right can spare its first child
+  {
+    c->keys[c->n] = in->keys[i];                                           // old separator comes down
+    c->child[++c->n] = right->child[0];                                    // right's first child moves over
+    in->keys[i] = right->keys[0];                                          // right's first separator goes up
+    memmove(right->keys, right->keys + 1, (right->n - 1) * sizeof(key_t)); // close the gaps
+    memmove(right->child, right->child + 1, right->n * sizeof(void *));    // close the gaps
+    right->n--;                                                            // one child less there
+    return;                                                                // done
+  }
+  const int k = left != NULL ? i - 1 : i;                                          // merge child k + 1 into child k
+  btinner_t *l = (btinner_t *)in->child[k];                                        // survivor
+  btinner_t *r = (btinner_t *)in->child[k + 1];                                    // emptied
+  l->keys[l->n] = in->keys[k];                                                     // separator comes down between them
+  memcpy(l->keys + l->n + 1, r->keys, r->n * sizeof(key_t));                       // then r's separators
+  memcpy(l->child + l->n + 1, r->child, (r->n + 1) * sizeof(void *));              // and children
+  l->n += r->n + 1;                                                                // both at half or less: they fit
+  memmove(in->keys + k, in->keys + k + 1, (in->n - k - 1) * sizeof(key_t));        // drop the separator
+  memmove(in->child + k + 1, in->child + k + 2, (in->n - k - 1) * sizeof(void *)); // and r
+  in->n--;                                                                         // one child less
+  free(r);                                                                         // release it
+}
+
+/* Purpose: Remove one copy of key from subtree n (`level` above the leaves), refilling children on the way back; returns 0 if absent. */
+static int erase_below(void *n, const int level, const key_t key)
+{
+  if (level == 0) // leaf
+  {
+    btleaf_t *l = (btleaf_t *)n;                                           // leaf view
+    const int i = rank_below(l->keys, l->n, RBTREE_BT_LEAF_KEYS, key);     // first copy, if here
+    if (i == l->n || l->keys[i] != key)                                    // not in this leaf
+      return 0;                                                            // caller may try the next child
+    memmove(l->keys + i, l->keys + i + 1, (l->n - i - 1) * sizeof(key_t)); // close the gap
+    l->n--;                                                                // one key less
+    return 1;                                                              // removed
+  }
+  btinner_t *in = (btinner_t *)n;                                                       // inner view
+  for (int i = rank_below(in->keys, in->n, RBTREE_BT_INNER_KEYS, key); i <= in->n; i++) // copies may straddle equal separators
+  {
+    if (erase_below(in->child[i], level - 1, key)) // removed below
+    {
+      const int min = level == 1 ? LEAF_MIN : INNER_MIN; // fill the child must keep
+      if (((btleaf_t *)in->child[i])->n < min)           // n leads both node types
+      {
+        if (level == 1)    // children are leaves
+          fix_leaf(in, i); // borrow or merge
+        else
+          fix_inner(in, i); // borrow or merge
+      }
+      return 1; // removed
+    }
+    if (i == in->n || in->keys[i] != key) // later children only hold larger keys
+      break;                              // key is absent
+  }
+  return 0; // not found
+}
+
+/* Purpose: Remove one copy of key; returns 0 if the key is absent. */
+int rbtree_bt_erase(rbtree_bt *t, const key_t key)
+{
+  if (t == NULL || t->root == NULL)                    // nothing to erase
+    return 0;                                          // nothing done
+  if (!erase_below(t->root, t->height, key))           // not present
+    return 0;                                          // nothing done
+  t->count--;                                          // one key less
+  if (t->height > 0 && ((btinner_t *)t->root)->n == 0) // root kept a single child after a merge
+  {
+    void *only = ((btinner_t *)t->root)->child[0]; // it becomes the root
+    free(t->root);                                 // drop the old one
+    t->root = only;                                // attach
+    t->height--;                                   // one level less
+  }
+  else if (t->height == 0 && t->count == 0) // last key gone
+  {
+    free(t->root);            // drop the empty leaf
+    t->root = t->head = NULL; // empty tree
+  }
+  return 1; // removed
+}
+
+/* Purpose: Copy up to n keys in order into arr by walking the leaf chain; returns how many were copied. */
+int rbtree_bt_to_array(const rbtree_bt *t, key_t *arr, const size_t n)
+{
+  size_t i = 0;                                                      // keys written
+  for (const btleaf_t *l = t->head; l != NULL && i < n; l = l->next) // leaves in key order
+  {
+    const size_t take = (size_t)l->n < n - i ? (size_t)l->n : n - i; // whole leaf unless arr runs out
+    memcpy(arr + i, l->keys, take * sizeof(key_t));                  // one block per leaf
+    i += take;                                                       // advance
+  }
+  return (int)i; // keys written
+}
@@ -0,0 +1,56 @@
+#ifndef _RBTREE_BTREE_H_
+#define _RBTREE_BTREE_H_
+
+#include "rbtree.h"
+
+// Multiway (B+ tree) ordered multiset with the same contract as rbtree.h: a node holds dozens of
+// keys in a few cache lines and is searched locally, so a lookup misses the cache once per level
+// instead of once per key, and the tree is 4-6x shallower than a binary one.
+//
+// Keys live in the leaves, which are chained in key order; inner nodes only hold separators.
+// Keys move between nodes when they split or merge, so the key pointers returned by find, min, max
+// and lower_bound are only valid until the next insert or erase.
+
+#ifndef RBTREE_BT_NODE_BYTES
+#define RBTREE_BT_NODE_BYTES 256 // four cache lines per node
+#endif
+
+// n and the padding after it take one pointer's worth; both counts are multiples of 4 for int keys
+#define RBTREE_BT_LEAF_KEYS ((RBTREE_BT_NODE_BYTES - 2 * sizeof(void *)) / sizeof(key_t))                     // 60 int keys
+#define RBTREE_BT_INNER_KEYS ((RBTREE_BT_NODE_BYTES - 2 * sizeof(void *)) / (sizeof(key_t) + sizeof(void *))) // 20 int keys
+
+typedef struct btleaf_t
+{
+  int n;                           // keys in use; at least half full unless it is the root
+  key_t keys[RBTREE_BT_LEAF_KEYS]; // sorted, duplicates adjacent
+  struct btleaf_t *next;           // next leaf in key order, NULL for the last
+} btleaf_t;
+
+typedef struct btinner_t
+{
+  int n;                                 // separators in use; children are n + 1
+  key_t keys[RBTREE_BT_INNER_KEYS];      // keys[i] lies between the keys of child[i] and child[i + 1]
+  void *child[RBTREE_BT_INNER_KEYS + 1]; // btinner_t, or btleaf_t one level above the leaves
+} btinner_t;
+
+typedef struct
+{
+  void *root;     // NULL when empty
+  int height;     // inner levels above the leaves (0: the root is a leaf)
+  size_t count;   // number of keys stored
+  btleaf_t *head; // first leaf, NULL when empty
+} rbtree_bt;
+
+rbtree_bt *new_rbtree_bt(void);
+void delete_rbtree_bt(rbtree_bt *);
+
+int rbtree_bt_insert(rbtree_bt *, const key_t);
+const key_t *rbtree_bt_find(const rbtree_bt *, const key_t);
+const key_t *rbtree_bt_min(const rbtree_bt *);
+const key_t *rbtree_bt_max(const rbtree_bt *);
+const key_t *rbtree_bt_lower_bound(const rbtree_bt *, const key_t);
+int rbtree_bt_erase(rbtree_bt *, const key_t);
+
+int rbtree_bt_to_array(const rbtree_bt *, key_t *, const size_t);
+
+#endif // _RBTREE_BTREE_H_
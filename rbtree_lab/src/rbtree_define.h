@@ -0,0 +1,427 @@
+#ifndef _RBTREE_DEFINE_H_
+#define _RBTREE_DEFINE_H_
+
+#include "rbtree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Type-specialized red-black trees. RBTREE_DEFINE(name, key_type, less) stamps out the tree type
+// `name`, its node type `name##_node` and new_##name, delete_##name, name##_insert, _find,
+// _lower_bound, _min, _max, _next, _prev, _erase and _to_array with the contracts of their rbtree.h
+// counterparts (min and max of an empty tree return NULL rather than the sentinel). They are static
+// inline, so `less(a, b)` (a macro or an inline function) is expanded at every comparison instead of
+// going through a function pointer. Nodes come from a per-tree slab like rbtree.c's. Each .c file
+// that uses a tree type expands the macro once at file scope, without a trailing semicolon.
+//
+// find tests equality as !less(a, b) && !less(b, a); for integers the compiler folds the pair into
+// one compare. less must be a strict weak order, so double trees must not hold NaN.
+#ifndef RBTREE_DEFINE_CHUNK_NODES
+#define RBTREE_DEFINE_CHUNK_NODES 1024 // nodes in a tree's first slab chunk
+#endif
+
+#ifndef RBTREE_DEFINE_CHUNK_NODES_MAX
+#define RBTREE_DEFINE_CHUNK_NODES_MAX (1u << 22) // chunks double up to this many nodes
+#endif
+
+#define RBTREE_LESS(a, b) ((a) < (b))                 // numeric keys
+#define RBTREE_STR_LESS(a, b) (strcmp((a), (b)) < 0) // NUL-terminated strings, compared bytewise
+
+#define RBTREE_DEFINE(name, key_type, less)                                                                             \
+  typedef struct name##_node                                                                                            \
+  {                                                                                                                     \
+    color_t color;                                                                                                      \
+    key_type key;                                                                                                       \
+    struct name##_node *parent;                                                                                         \
+    union                                                                                                               \
+    {                                                                                                                   \
+      struct                                                                                                            \
+      {                                                                                                                 \
+        struct name##_node *left, *right;                                                                               \
+      };                                                                                                                \
+      struct name##_node *child[2]; /* child[0] is left: find indexes instead of branching */                           \
+    };                                                                                                                  \
+  } name##_node;                                                                                                        \
+                                                                                                                        \
+  struct name##_chunk                                                                                                   \
+  {                                                                                                                     \
+    struct name##_chunk *next;                                                                                          \
+    size_t cap;                                                                                                         \
+    name##_node nodes[];                                                                                                \
+  };                                                                                                                    \
+                                                                                                                        \
+  typedef struct                                                                                                        \
+  {                                                                                                                     \
+    name##_node *root;                                                                                                  \
+    name##_node *nil;                                                                                                   \
+    size_t count;                                                                                                       \
+    struct name##_chunk *chunks;                                                                                        \
+    name##_node *free_list;                                                                                             \
+    size_t chunk_left;                                                                                                  \
+  } name;                                                                                                               \
+                                                                                                                        \
+  static inline name *new_##name(void)                                                                                  \
+  {                                                                                                                     \
+    name *t = (name *)calloc(1, sizeof(name));                                                                          \
+    name##_node *nil = (name##_node *)calloc(1, sizeof(name##_node));                                                   \
+    if (t == NULL || nil == NULL)                                                                                       \
+    {                                                                                                                   \
+      free(t);                                                                                                          \
+      free(nil);                                                                                                        \
+      return NULL;                                                                                                      \
+    }                                                                                                                   \
+    nil->color = RBTREE_BLACK;                                                                                          \
+    nil->parent = nil->left = nil->right = nil;                                                                         \
+    t->nil = nil;                                                                                                       \
+    t->root = nil;                                                                                                      \
+    return t;                                                                                                           \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline void delete_##name(name *t)                                                                             \
+  {                                                                                                                     \
+    if (t == NULL)                                                                                                      \
+      return;                                                                                                           \
+    while (t->chunks != NULL)                                                                                           \
+    {                                                                                                                   \
+      struct name##_chunk *next = t->chunks->next;                                                                      \
+      free(t->chunks);                                                                                                  \
+      t->chunks = next;                                                                                                 \
+    }                                                                                                                   \
+    free(t->nil);                                                                                                       \
+    free(t);                                                                                                            \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_node_alloc(name *t)                                                                 \
+  {                                                                                                                     \
+    name##_node *n = t->free_list;                                                                                      \
+    if (n != NULL)                                                                                                      \
+    {                                                                                                                   \
+      t->free_list = n->right;                                                                                          \
+      return n;                                                                                                         \
+    }                                                                                                                   \
+    if (t->chunk_left == 0)                                                                                             \
+    {                                                                                                                   \
+      size_t cap = t->chunks == NULL ? RBTREE_DEFINE_CHUNK_NODES : t->chunks->cap * 2;                                  \
+      if (cap > RBTREE_DEFINE_CHUNK_NODES_MAX)                                                                          \
+        cap = RBTREE_DEFINE_CHUNK_NODES_MAX;                                                                            \
+      struct name##_chunk *c = (struct name##_chunk *)calloc(1, sizeof(struct name##_chunk) + cap * sizeof(name##_node)); \
+      if (c == NULL)                                                                                                    \
+        return NULL;                                                                                                    \
+      c->next = t->chunks;                                                                                              \
+      c->cap = cap;                                                                                                     \
+      t->chunks = c;                                                                                                    \
+      t->chunk_left = cap;                                                                                              \
+    }                                                                                                                   \
+    return &t->chunks->nodes[t->chunks->cap - t->chunk_left--];                                                         \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline void name##_rotate_left(name *t, name##_node *x)                                                        \
+  {                                                                                                                     \
+    name##_node *y = x->right;                                                                                          \
+    x->right = y->left;                                                                                                 \
+    if (y->left != t->nil)                                                                                              \
+      y->left->parent = x;                                                                                              \
+    y->parent = x->parent;                                                                                              \
+    if (x->parent == t->nil)                                                                                            \
+      t->root = y;                                                                                                      \
+    else if (x == x->parent->left)                                                                                      \
+      x->parent->left = y;                                                                                              \
+    else                                                                                                                \
+      x->parent->right = y;                                                                                             \
+    y->left = x;                                                                                                        \
+    x->parent = y;                                                                                                      \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline void name##_rotate_right(name *t, name##_node *x)                                                       \
+  {                                                                                                                     \
+    name##_node *y = x->left;                                                                                           \
+    x->left = y->right;                                                                                                 \
+    if (y->right != t->nil)                                                                                             \
+      y->right->parent = x;                                                                                             \
+    y->parent = x->parent;                                                                                              \
+    if (x->parent == t->nil)                                                                                            \
+      t->root = y;                                                                                                      \
+    else if (x == x->parent->right)                                                                                     \
+      x->parent->right = y;                                                                                             \
+    else                                                                                                                \
+      x->parent->left = y;                                                                                              \
+    y->right = x;                                                                                                       \
+    x->parent = y;                                                                                                      \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_insert(name *t, const key_type key)                                                 \
+  {                                                                                                                     \
+    name##_node *z = name##_node_alloc(t);                                                                              \
+    if (z == NULL)                                                                                                      \
+      return NULL;                                                                                                      \
+    z->key = key;                                                                                                       \
+    z->color = RBTREE_RED;                                                                                              \
+    z->left = z->right = t->nil;                                                                                        \
+    name##_node *const inserted = z;                                                                                    \
+    name##_node *y = t->nil;                                                                                            \
+    name##_node *x = t->root;                                                                                           \
+    while (x != t->nil)                                                                                                 \
+    {                                                                                                                   \
+      y = x;                                                                                                            \
+      if (less(key, x->key))                                                                                            \
+        x = x->left;                                                                                                    \
+      else                                                                                                              \
+        x = x->right; /* duplicates go right */                                                                         \
+    }                                                                                                                   \
+    z->parent = y;                                                                                                      \
+    if (y == t->nil)                                                                                                    \
+      t->root = z;                                                                                                      \
+    else if (less(key, y->key))                                                                                         \
+      y->left = z;                                                                                                      \
+    else                                                                                                                \
+      y->right = z;                                                                                                     \
+    while (z->parent->color == RBTREE_RED)                                                                              \
+    {                                                                                                                   \
+      name##_node *g = z->parent->parent;                                                                               \
+      if (z->parent == g->left)                                                                                         \
+      {                                                                                                                 \
+        name##_node *u = g->right;                                                                                      \
+        if (u->color == RBTREE_RED)                                                                                     \
+        {                                                                                                               \
+          z->parent->color = u->color = RBTREE_BLACK;                                                                   \
+          g->color = RBTREE_RED;                                                                                        \
+          z = g;                                                                                                        \
+          continue;                                                                                                     \
+        }                                                                                                               \
+        if (z == z->parent->right)                                                                                      \
+        {                                                                                                               \
+          z = z->parent;                                                                                                \
+          name##_rotate_left(t, z);                                                                                     \
+        }                                                                                                               \
+        z->parent->color = RBTREE_BLACK;                                                                                \
+        g->color = RBTREE_RED;                                                                                          \
+        name##_rotate_right(t, g);                                                                                      \
+      }                                                                                                                 \
+      else                                                                                                              \
+      {                                                                                                                 \
+        name##_node *u = g->left;                                                                                       \
+        if (u->color == RBTREE_RED)                                                                                     \
+        {                                                                                                               \
+          z->parent->color = u->color = RBTREE_BLACK;                                                                   \
+          g->color = RBTREE_RED;                                                                                        \
+          z = g;                                                                                                        \
+          continue;                                                                                                     \
+        }                                                                                                               \
+        if (z == z->parent->left)                                                                                       \
+        {                                                                                                               \
+          z = z->parent;                                                                                                \
+          name##_rotate_right(t, z);                                                                                    \
+        }                                                                                                               \
+        z->parent->color = RBTREE_BLACK;                                                                                \
+        g->color = RBTREE_RED;                                                                                          \
+        name##_rotate_left(t, g);                                                                                       \
+      }                                                                                                                 \
+    }                                                                                                                   \
+    t->root->color = RBTREE_BLACK;                                                                                      \
+    t->count++;                                                                                                         \
+    return inserted;                                                                                                    \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_find(const name *t, const key_type key)                                             \
+  {                                                                                                                     \
+    name##_node *curr = t->root;                                                                                        \
+    while (curr != t->nil)                                                                                              \
+    {                                                                                                                   \
+      const int go_right = less(curr->key, key);                                                                        \
+      if (!go_right && !less(key, curr->key))                                                                           \
+        return curr;                                                                                                    \
+      curr = curr->child[go_right];                                                                                     \
+    }                                                                                                                   \
+    return NULL;                                                                                                        \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_lower_bound(const name *t, const key_type key)                                      \
+  {                                                                                                                     \
+    name##_node *best = NULL;                                                                                           \
+    name##_node *curr = t->root;                                                                                        \
+    while (curr != t->nil)                                                                                              \
+    {                                                                                                                   \
+      const int go_right = less(curr->key, key);                                                                        \
+      if (!go_right)                                                                                                    \
+        best = curr;                                                                                                    \
+      curr = curr->child[go_right];                                                                                     \
+    }                                                                                                                   \
+    return best;                                                                                                        \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_min(const name *t)                                                                  \
+  {                                                                                                                     \
+    name##_node *curr = t->root;                                                                                        \
+    if (curr == t->nil)                                                                                                 \
+      return NULL;                                                                                                      \
+    while (curr->left != t->nil)                                                                                        \
+      curr = curr->left;                                                                                                \
+    return curr;                                                                                                        \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_max(const name *t)                                                                  \
+  {                                                                                                                     \
+    name##_node *curr = t->root;                                                                                        \
+    if (curr == t->nil)                                                                                                 \
+      return NULL;                                                                                                      \
+    while (curr->right != t->nil)                                                                                       \
+      curr = curr->right;                                                                                               \
+    return curr;                                                                                                        \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_next(const name *t, const name##_node *p)                                           \
+  {                                                                                                                     \
+    if (p->right != t->nil)                                                                                             \
+    {                                                                                                                   \
+      p = p->right;                                                                                                     \
+      while (p->left != t->nil)                                                                                         \
+        p = p->left;                                                                                                    \
+      return (name##_node *)p;                                                                                          \
+    }                                                                                                                   \
+    while (p->parent != t->nil && p == p->parent->right)                                                                \
+      p = p->parent;                                                                                                    \
+    return p->parent == t->nil ? NULL : p->parent;                                                                      \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline name##_node *name##_prev(const name *t, const name##_node *p)                                           \
+  {                                                                                                                     \
+    if (p->left != t->nil)                                                                                              \
+    {                                                                                                                   \
+      p = p->left;                                                                                                      \
+      while (p->right != t->nil)                                                                                        \
+        p = p->right;                                                                                                   \
+      return (name##_node *)p;                                                                                          \
+    }                                                                                                                   \
+    while (p->parent != t->nil && p == p->parent->left)                                                                 \
+      p = p->parent;                                                                                                    \
+    return p->parent == t->nil ? NULL : p->parent;                                                                      \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline void name##_transplant(name *t, name##_node *u, name##_node *v)                                         \
+  {                                                                                                                     \
+    if (u->parent == t->nil)                                                                                            \
+      t->root = v;                                                                                                      \
+    else if (u == u->parent->left)                                                                                      \
+      u->parent->left = v;                                                                                              \
+    else                                                                                                                \
+      u->parent->right = v;                                                                                             \
+    v->parent = u->parent;                                                                                              \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline int name##_erase(name *t, name##_node *z)                                                               \
+  {                                                                                                                     \
+    if (z == NULL || z == t->nil)                                                                                       \
+      return 0;                                                                                                         \
+    name##_node *y = z;                                                                                                 \
+    name##_node *x;                                                                                                     \
+    color_t removed = y->color;                                                                                         \
+    if (z->left == t->nil)                                                                                              \
+    {                                                                                                                   \
+      x = z->right;                                                                                                     \
+      name##_transplant(t, z, x);                                                                                       \
+    }                                                                                                                   \
+    else if (z->right == t->nil)                                                                                        \
+    {                                                                                                                   \
+      x = z->left;                                                                                                      \
+      name##_transplant(t, z, x);                                                                                       \
+    }                                                                                                                   \
+    else                                                                                                                \
+    {                                                                                                                   \
+      y = z->right;                                                                                                     \
+      while (y->left != t->nil)                                                                                         \
+        y = y->left;                                                                                                    \
+      removed = y->color;                                                                                               \
+      x = y->right;                                                                                                     \
+      if (y->parent == z)                                                                                               \
+        x->parent = y; /* may set the sentinel's parent, which the fixup reads */                                       \
+      else                                                                                                              \
+      {                                                                                                                 \
+        name##_transplant(t, y, x);                                                                                     \
+        y->right = z->right;                                                                                            \
+        y->right->parent = y;                                                                                           \
+      }                                                                                                                 \
+      name##_transplant(t, z, y);                                                                                       \
+      y->left = z->left;                                                                                                \
+      y->left->parent = y;                                                                                              \
+      y->color = z->color;                                                                                              \
+    }                                                                                                                   \
+    if (removed == RBTREE_BLACK)                                                                                        \
+    {                                                                                                                   \
+      while (x != t->root && x->color == RBTREE_BLACK)                                                                  \
+      {                                                                                                                 \
+        if (x == x->parent->left)                                                                                       \
+        {                                                                                                               \
+          name##_node *w = x->parent->right;                                                                            \
+          if (w->color == RBTREE_RED)                                                                                   \
+          {                                                                                                             \
+            w->color = RBTREE_BLACK;                                                                                    \
+            x->parent->color = RBTREE_RED;                                                                              \
+            name##_rotate_left(t, x->parent);                                                                           \
+            w = x->parent->right;                                                                                       \
+          }                                                                                                             \
+          if (w->left->color == RBTREE_BLACK && w->right->color == RBTREE_BLACK)                                        \
+          {                                                                                                             \
+            w->color = RBTREE_RED;                                                                                      \
+            x = x->parent;                                                                                              \
+            continue;                                                                                                   \
+          }                                                                                                             \
+          if (w->right->color == RBTREE_BLACK)                                                                          \
+          {                                                                                                             \
+            w->left->color = RBTREE_BLACK;                                                                              \
+            w->color = RBTREE_RED;                                                                                      \
+            name##_rotate_right(t, w);                                                                                  \
+            w = x->parent->right;                                                                                       \
+          }                                                                                                             \
+          w->color = x->parent->color;                                                                                  \
+          x->parent->color = RBTREE_BLACK;                                                                              \
+          w->right->color = RBTREE_BLACK;                                                                               \
+          name##_rotate_left(t, x->parent);                                                                             \
+          x = t->root;                                                                                                  \
+        }                                                                                                               \
+        else                                                                                                            \
+        {                                                                                                               \
+          name##_node *w = x->parent->left;                                                                             \
+          if (w->color == RBTREE_RED)                                                                                   \
+          {                                                                                                             \
+            w->color = RBTREE_BLACK;                                                                                    \
+            x->parent->color = RBTREE_RED;                                                                              \
+            name##_rotate_right(t, x->parent);                                                                          \
+            w = x->parent->left;                                                                                        \
+          }                                                                                                             \
+          if (w->right->color == RBTREE_BLACK && w->left->color == RBTREE_BLACK)                                        \
+          {                                                                                                             \
+            w->color = RBTREE_RED;                                                                                      \
+            x = x->parent;                                                                                              \
+            continue;                                                                                                   \
+          }                                                                                                             \
+          if (w->left->color == RBTREE_BLACK)                                                                           \
+          {                                                                                                             \
+            w->right->color = RBTREE_BLACK;                                                                             \
+            w->color = RBTREE_RED;                                                                                      \
+            name##_rotate_left(t, w);                                                                                   \
+            w = x->parent->left;                                                                                        \
+          }                                                                                                             \
+          w->color = x->parent->color;                                                                                  \
+          x->parent->color = RBTREE_BLACK;                                                                              \
+          w->left->color = RBTREE_BLACK;                                                                                \
+          name##_rotate_right(t, x->parent);                                                                            \
+          x = t->root;                                                                                                  \
+        }                                                                                                               \
+      }                                                                                                                 \
+      x->color = RBTREE_BLACK;                                                                                          \
+    }                                                                                                                   \
+    z->right = t->free_list;                                                                                            \
+    t->free_list = z;                                                                                                   \
+    t->count--;                                                                                                         \
+    return 1;                                                                                                           \
+  }                                                                                                                     \
+                                                                                                                        \
+  static inline size_t name##_to_array(const name *t, key_type *arr, const size_t n)                                    \
+  {                                                                                                                     \
+    size_t i = 0;                                                                                                       \
+    for (const name##_node *p = name##_min(t); p != NULL && i < n; p = name##_next(t, p))                               \
+      arr[i++] = p->key;                                                                                                \
+    return i;                                                                                                           \
+  }
+
+#endif // _RBTREE_DEFINE_H_
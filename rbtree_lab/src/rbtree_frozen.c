@@ -0,0 +1,102 @@
+#include "rbtree_frozen.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define KEYS_PER_LINE (64 / sizeof(key_t)) // slots 16k..16k+15 share a cache line: the 16 descendants four levels below k
+
+/* Purpose: Lay the nodes from cursor on (in key order) into the implicit subtree rooted at slot k; returns the next node. */
+static node_t *fill(const rbtree *t, rbtree_frozen *f, const size_t k, node_t *cursor)
+{
+  if (k > f->n)                                           // past the last slot
+    return cursor;                                        // nothing placed
+  cursor = fill(t, f, 2 * k, cursor);                     // smaller keys first
+  f->keys[k] = cursor->key;                               // in-order position of slot k
+  f->nodes[k] = cursor;                                   // remember where it came from
+  cursor = fill(t, f, 2 * k + 1, rbtree_next(t, cursor)); // then larger keys
+  return cursor;                                          // first node not placed yet
+}
+
+/* Purpose: Copy the tree's keys into a new Eytzinger-ordered snapshot; returns NULL when out of memory. */
+rbtree_frozen *rbtree_freeze(const rbtree *t)
+{
+  if (t == NULL)                                             // invalid input
+    return NULL;                                             // nothing to freeze
+  rbtree_frozen *f = (rbtree_frozen *)calloc(1, sizeof(*f)); // snapshot header
+  if (f == NULL)                                             // out of memory
+    return NULL;                                             // report failure
+#ifdef RBTREE_COUNTED
+  for (node_t *p = t->count > 0 ? rbtree_min(t) : NULL; p != NULL; p = rbtree_next(t, p)) // count holds copies: count nodes
+    f->n++;                                                                                // one slot per node
+#else
+  f->n = t->count; // one slot per key
+#endif
+  const size_t bytes = ((f->n + 1) * sizeof(key_t) + 63) / 64 * 64; // whole cache lines, slot 0 included
+  f->keys = (key_t *)aligned_alloc(64, bytes);                      // slot 16k starts a line
+  f->nodes = (node_t **)malloc((f->n + 1) * sizeof(node_t *));      // read once per hit
+  if (f->keys == NULL || f->nodes == NULL)                          // out of memory
+  {
+    delete_rbtree_frozen(f); // drop what was allocated
+    return NULL;             // report failure
+  }
+  memset(f->keys, 0, bytes);    // slot 0 and the tail of the last line are never read as keys
+  f->nodes[0] = NULL;           // "no slot" maps to NULL
+  fill(t, f, 1, rbtree_min(t)); // in-order walk of the implicit tree
+  return f;                     // done
+}
+
+/* Purpose: Free a snapshot; the tree it was taken from is untouched. */
+void delete_rbtree_frozen(rbtree_frozen *f)
+{
+  if (f == NULL)  // nothing to do if snapshot is NULL
+    return;       // early return
+  free(f->keys);  // free(NULL) is fine
+  free(f->nodes); // free(NULL) is fine
+  free(f);        // free header
+}
+
+/* Purpose: Return the slot of the first key >= key, or 0 if every key is smaller. */
+static size_t lower_slot(const rbtree_frozen *f, const key_t key)
+{
+  const key_t *keys = f->keys; // base of the implicit tree
+  size_t k = 1;                // root slot
+#ifdef __AVX2__
+  const __m256i needle = _mm256_set1_epi32(key); // key in every lane
+  while (8 * k + 7 <= f->n)                      // the three levels below k are complete
+  {
+    __builtin_prefetch(keys + 32 * k);                                                            // next block's bottom level: 32 slots
+    __builtin_prefetch(keys + 32 * k + KEYS_PER_LINE);                                            // over two lines
+    const __m128i bottom = _mm_loadu_si128((const __m128i *)(keys + 4 * k));                      // slots 4k..4k+3
+    const __m128i top = _mm_set_epi32(key, keys[k], keys[2 * k + 1], keys[2 * k]);                // slots 2k, 2k+1, k and a lane that never counts
+    const __m256i block = _mm256_set_m128i(top, bottom);                                          // the seven keys of a three-level subtree
+    const int below = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, block))); // lanes with a key < key
+    k = 8 * k + (size_t)__builtin_popcount(below);                                                // how many are smaller is the path taken
+  }
+#endif
+  while (k <= f->n) // one level per step
+  {
+    __builtin_prefetch(keys + KEYS_PER_LINE * k); // the line four levels down
+    k = 2 * k + (keys[k] < key);                  // right when the slot is smaller: no branch
+  }
+  return k >> __builtin_ffsll((long long)~k); // undo the right turns taken after the last left one
+}
+
+/* Purpose: Return the node of the first key >= key (valid until the tree changes), or NULL if every key is smaller. */
+node_t *rbtree_frozen_lower_bound(const rbtree_frozen *f, const key_t key)
+{
+  if (f == NULL)                       // invalid input
+    return NULL;                       // nothing to search
+  return f->nodes[lower_slot(f, key)]; // slot 0 maps to NULL
+}
+
+/* Purpose: Return a node holding key (valid until the tree changes), or NULL. */
+node_t *rbtree_frozen_find(const rbtree_frozen *f, const key_t key)
+{
+  if (f == NULL)                                           // invalid input
+    return NULL;                                           // nothing to search
+  const size_t k = lower_slot(f, key);                     // first key >= key
+  return k != 0 && f->keys[k] == key ? f->nodes[k] : NULL; // present only if equal
+}
@@ -0,0 +1,27 @@
+#ifndef _RBTREE_FROZEN_H_
+#define _RBTREE_FROZEN_H_
+
+#include "rbtree.h"
+
+// Read-only snapshot of a tree for build-once, query-many workloads. rbtree_freeze copies the keys
+// into one array in Eytzinger (BFS) order: the children of slot k are 2k and 2k + 1, so a search
+// touches a predictable chain of slots, fetched ahead with prefetches, and picks the next slot with
+// arithmetic instead of a branch. Built with -mavx2, one 8-lane compare descends three levels at once.
+//
+// Queries return the tree's own node_t pointers, like rbtree_find and rbtree_lower_bound, so a
+// snapshot is valid until the next change to its tree; free it and freeze again after that.
+// Counted builds keep one slot per node.
+typedef struct
+{
+  size_t n;       // slots in use: keys[1..n]
+  key_t *keys;    // keys in Eytzinger order; keys[0] is unused, the array is cache-line aligned
+  node_t **nodes; // nodes[k] is the node keys[k] came from
+} rbtree_frozen;
+
+rbtree_frozen *rbtree_freeze(const rbtree *);
+void delete_rbtree_frozen(rbtree_frozen *);
+
+node_t *rbtree_frozen_find(const rbtree_frozen *, const key_t);
+node_t *rbtree_frozen_lower_bound(const rbtree_frozen *, const key_t);
+
+#endif // _RBTREE_FROZEN_H_
@@ -0,0 +1,416 @@
+#include "rbtree_index.h"
+
+#include <stdlib.h>
+
+#ifndef RBTREE_IDX_INITIAL
+#define RBTREE_IDX_INITIAL 1024 // slots in the array of a tree created without a capacity
+#endif
+
+#define RBIDX_MAX_SLOTS (1u << 31) // parent indices keep one bit for the color
+
+#define nd(t, i) ((t)->nodes[i])
+#define parent_of(t, i) (nd(t, i).parent_color >> 1)
+#define color_of(t, i) ((color_t)(nd(t, i).parent_color & 1))
+#define set_parent(t, i, p) (nd(t, i).parent_color = (uint32_t)(p) << 1 | (nd(t, i).parent_color & 1))
+#define set_color(t, i, c) (nd(t, i).parent_color = (nd(t, i).parent_color & ~1u) | (uint32_t)(c))
+
+/* Purpose: Resize the node array to cap slots; returns 0 on allocation failure. */
+static int grow(rbtree_idx *t, size_t cap)
+{
+  if (cap > RBIDX_MAX_SLOTS)                                            // index space is the limit
+    cap = RBIDX_MAX_SLOTS;                                              // clamp
+  if (cap <= t->cap)                                                    // clamped to the current size: no indices left
+    return 0;                                                           // cannot grow
+  inode_t *nodes = (inode_t *)realloc(t->nodes, cap * sizeof(inode_t)); // may move: handles stay valid
+  if (nodes == NULL)                                                    // out of memory
+    return 0;                                                           // old array untouched
+  t->nodes = nodes;                                                     // install
+  t->cap = (uint32_t)cap;                                               // new size
+  return 1;                                                             // success
+}
+
+/* Purpose: Get a free slot: an erased one first, then the next unused one, growing the array when full. */
+static rbidx_t slot_alloc(rbtree_idx *t)
+{
+  rbidx_t i = t->free_list; // try the free list first
+  if (i != RBIDX_NIL)
+  {
+    t->free_list = nd(t, i).right; // pop recycled slot
+    return i;                      // reuse it
+  }
+  if (t->used == t->cap && !grow(t, (size_t)t->cap * 2)) // array full: double it
+    return RBIDX_NIL;                                    // out of memory or out of indices
+  return t->used++;                                      // next slot in array order
+}
+
+/* Purpose: Create an empty tree whose array already holds room for `capacity` nodes. */
+rbtree_idx *new_rbtree_idx_with_capacity(const size_t capacity)
+{
+  rbtree_idx *t = (rbtree_idx *)calloc(1, sizeof(rbtree_idx));    // allocate tree struct
+  if (t == NULL)                                                  // out of memory
+    return NULL;                                                  // report failure
+  if (!grow(t, capacity > 0 ? capacity + 1 : RBTREE_IDX_INITIAL)) // room for the sentinel too
+  {
+    free(t);     // nothing else was allocated
+    return NULL; // report failure
+  }
+  nd(t, RBIDX_NIL) = (inode_t){0, RBIDX_NIL, RBIDX_NIL, RBIDX_NIL << 1 | RBTREE_BLACK}; // black sentinel
+  t->used = 1;                                                                          // slot 0 is taken
+  t->root = RBIDX_NIL;                                                                  // empty tree
+  return t;                                                                             // ready
+}
+
+/* Purpose: Create an empty tree. */
+rbtree_idx *new_rbtree_idx(void)
+{
+  return new_rbtree_idx_with_capacity(0); // default size, grows on demand
+}
+
+/* Purpose: Free the node array and the tree; no node is visited. */
+void delete_rbtree_idx(rbtree_idx *t)
+{
+  if (t == NULL)  // nothing to do if tree is NULL
+    return;       // early return
+  free(t->nodes); // every node at once
+  free(t);        // free tree struct
+}
+
+/* Purpose: Replace subtree rooted at u with subtree rooted at v. */
+static void transplant(rbtree_idx *t, const rbidx_t u, const rbidx_t v)
+{
+  const rbidx_t up = parent_of(t, u); // u's parent
+  if (up == RBIDX_NIL)                // u is root
+    t->root = v;                      // v becomes new root
+  else if (u == nd(t, up).left)       // u is left child
+    nd(t, up).left = v;               // set left child to v
+  else
+    nd(t, up).right = v; // set right child to v
+  set_parent(t, v, up);  // may set the sentinel's parent, as rbtree.c does
+}
+
+/* Purpose: Left-rotate the subtree rooted at x. */
+static void rotate_left(rbtree_idx *t, const rbidx_t x)
+{
+  const rbidx_t y = nd(t, x).right;  // set y
+  nd(t, x).right = nd(t, y).left;    // turn y's left subtree into x's right
+  if (nd(t, y).left != RBIDX_NIL)    // if y's left exists
+    set_parent(t, nd(t, y).left, x); // update parent
+  transplant(t, x, y);               // y takes x's place
+  nd(t, y).left = x;                 // put x on y's left
+  set_parent(t, x, y);               // update x's parent
+}
+
+/* Purpose: Right-rotate the subtree rooted at x. */
+static void rotate_right(rbtree_idx *t, const rbidx_t x)
+{
+  const rbidx_t y = nd(t, x).left;    // set y
+  nd(t, x).left = nd(t, y).right;     // turn y's right subtree into x's left
+  if (nd(t, y).right != RBIDX_NIL)    // if y's right exists
+    set_parent(t, nd(t, y).right, x); // update parent
+  transplant(t, x, y);                // y takes x's place
+  nd(t, y).right = x;                 // put x on y's right
+  set_parent(t, x, y);                // update x's parent
+}
+
+/* Purpose: Restore red-black properties after insertion of node z. */
+static void rebuild_after_insert(rbtree_idx *t, rbidx_t z)
+{
+  while (color_of(t, parent_of(t, z)) == RBTREE_RED) // while parent is red
+  {
+    const rbidx_t p = parent_of(t, z), g = parent_of(t, p); // parent and grandparent
+    if (p == nd(t, g).left)                                 // parent is left child
+    {
+      const rbidx_t y = nd(t, g).right; // uncle
+      if (color_of(t, y) == RBTREE_RED) // case 1: uncle red
+      {
+        set_color(t, p, RBTREE_BLACK); // recolor parent black
+        set_color(t, y, RBTREE_BLACK); // recolor uncle black
+        set_color(t, g, RBTREE_RED);   // recolor grandparent red
+        z = g;                         // move z up
+      }
+      else
+      {
+        if (z == nd(t, p).right) // case 2: z is right child
+        {
+          z = p;             // move z up
+          rotate_left(t, z); // rotate left
+        }
+        set_color(t, parent_of(t, z), RBTREE_BLACK); // case 3: recolor parent
+        set_color(t, g, RBTREE_RED);                 // recolor grandparent
+        rotate_right(t, g);                          // rotate right
+      }
+    }
+    else
+    {
+      const rbidx_t y = nd(t, g).left;  // uncle
+      if (color_of(t, y) == RBTREE_RED) // case 1 mirror
+      {
+        set_color(t, p, RBTREE_BLACK); // recolor parent
+        set_color(t, y, RBTREE_BLACK); // recolor uncle
+        set_color(t, g, RBTREE_RED);   // recolor grandparent
+        z = g;                         // move z up
+      }
+      else
+      {
+        if (z == nd(t, p).left) // case 2 mirror
+        {
+          z = p;              // move z up
+          rotate_right(t, z); // rotate right
+        }
+        set_color(t, parent_of(t, z), RBTREE_BLACK); // recolor parent
+        set_color(t, g, RBTREE_RED);                 // recolor grandparent
+        rotate_left(t, g);                           // rotate left
+      }
+    }
+  }
+  set_color(t, t->root, RBTREE_BLACK); // ensure root is black
+}
+
+/* Purpose: Insert a key and return its handle, or RBIDX_NIL when out of memory or indices. */
+rbidx_t rbtree_idx_insert(rbtree_idx *t, const key_t key)
+{
+  const rbidx_t z = slot_alloc(t); // may move t->nodes, so no node address is held across it
+  if (z == RBIDX_NIL)              // out of memory
+    return RBIDX_NIL;              // nothing inserted
+
+  rbidx_t y = RBIDX_NIL; // y will track parent
+  rbidx_t x = t->root;   // start from root
+  while (x != RBIDX_NIL) // find insertion point
+  {
+    y = x;                                                   // update parent
+    x = key < nd(t, x).key ? nd(t, x).left : nd(t, x).right; // duplicates go right
+  }
+  nd(t, z) = (inode_t){key, RBIDX_NIL, RBIDX_NIL, y << 1 | RBTREE_RED}; // red leaf under y
+  if (y == RBIDX_NIL)                                                   // tree was empty
+    t->root = z;                                                        // new node is root
+  else if (key < nd(t, y).key)                                          // attach as left child
+    nd(t, y).left = z;                                                  // set left link
+  else
+    nd(t, y).right = z; // set right link
+
+  rebuild_after_insert(t, z); // fix red-black properties
+  t->count++;                 // one more key
+  return z;                   // handle of the new node
+}
+
+/* Purpose: Handle of a node holding key, or RBIDX_NIL. */
+rbidx_t rbtree_idx_find(const rbtree_idx *t, const key_t key)
+{
+  rbidx_t curr = t->root;   // start from root
+  while (curr != RBIDX_NIL) // traverse until sentinel
+  {
+    const inode_t *n = &nd(t, curr);          // 16 bytes: four nodes per cache line
+    if (key == n->key)                        // found
+      return curr;                            // return handle
+    curr = key < n->key ? n->left : n->right; // descend
+  }
+  return RBIDX_NIL; // not found
+}
+
+/* Purpose: Leftmost node of the subtree at i (i != RBIDX_NIL). */
+static rbidx_t subtree_min(const rbtree_idx *t, rbidx_t i)
+{
+  while (nd(t, i).left != RBIDX_NIL) // traverse left
+    i = nd(t, i).left;               // move left
+  return i;                          // leftmost
+}
+
+/* Purpose: Rightmost node of the subtree at i (i != RBIDX_NIL). */
+static rbidx_t subtree_max(const rbtree_idx *t, rbidx_t i)
+{
+  while (nd(t, i).right != RBIDX_NIL) // traverse right
+    i = nd(t, i).right;               // move right
+  return i;                           // rightmost
+}
+
+/* Purpose: Handle of the smallest key, or RBIDX_NIL if the tree is empty. */
+rbidx_t rbtree_idx_min(const rbtree_idx *t)
+{
+  return t->root == RBIDX_NIL ? RBIDX_NIL : subtree_min(t, t->root); // empty tree has no minimum
+}
+
+/* Purpose: Handle of the largest key, or RBIDX_NIL if the tree is empty. */
+rbidx_t rbtree_idx_max(const rbtree_idx *t)
+{
+  return t->root == RBIDX_NIL ? RBIDX_NIL : subtree_max(t, t->root); // empty tree has no maximum
+}
+
+/* Purpose: Handle of the first node (in order) with key >= key, or RBIDX_NIL. */
+rbidx_t rbtree_idx_lower_bound(const rbtree_idx *t, const key_t key)
+{
+  rbidx_t best = RBIDX_NIL; // best candidate so far
+  rbidx_t curr = t->root;   // start from root
+  while (curr != RBIDX_NIL) // traverse until sentinel
+  {
+    if (nd(t, curr).key >= key) // curr qualifies
+    {
+      best = curr;             // remember it
+      curr = nd(t, curr).left; // look for an earlier one
+    }
+    else
+      curr = nd(t, curr).right; // too small: go right
+  }
+  return best; // first qualifying node or RBIDX_NIL
+}
+
+/* Purpose: In-order successor of h, or RBIDX_NIL after the last node. */
+rbidx_t rbtree_idx_next(const rbtree_idx *t, rbidx_t h)
+{
+  if (h == RBIDX_NIL)                      // invalid input
+    return RBIDX_NIL;                      // nothing follows
+  if (nd(t, h).right != RBIDX_NIL)         // successor is the leftmost node of the right subtree
+    return subtree_min(t, nd(t, h).right); // descend
+  rbidx_t p = parent_of(t, h);             // climb while coming from the right
+  while (p != RBIDX_NIL && h == nd(t, p).right)
+  {
+    h = p;               // move up
+    p = parent_of(t, h); // next ancestor
+  }
+  return p; // first ancestor reached from the left, or RBIDX_NIL
+}
+
+/* Purpose: In-order predecessor of h, or RBIDX_NIL before the first node. */
+rbidx_t rbtree_idx_prev(const rbtree_idx *t, rbidx_t h)
+{
+  if (h == RBIDX_NIL)                     // invalid input
+    return RBIDX_NIL;                     // nothing precedes
+  if (nd(t, h).left != RBIDX_NIL)         // predecessor is the rightmost node of the left subtree
+    return subtree_max(t, nd(t, h).left); // descend
+  rbidx_t p = parent_of(t, h);            // climb while coming from the left
+  while (p != RBIDX_NIL && h == nd(t, p).left)
+  {
+    h = p;               // move up
+    p = parent_of(t, h); // next ancestor
+  }
+  return p; // first ancestor reached from the right, or RBIDX_NIL
+}
+
+/* Purpose: Restore red-black properties after deletion, starting from x. */
+static void rebuild_after_delete(rbtree_idx *t, rbidx_t x)
+{
+  while (x != t->root && color_of(t, x) == RBTREE_BLACK) // while x is double-black
+  {
+    const rbidx_t p = parent_of(t, x); // x's parent (valid for the sentinel too)
+    if (x == nd(t, p).left)            // x is left child
+    {
+      rbidx_t w = nd(t, p).right;       // sibling
+      if (color_of(t, w) == RBTREE_RED) // case 1
+      {
+        set_color(t, w, RBTREE_BLACK); // recolor sibling
+        set_color(t, p, RBTREE_RED);   // recolor parent
+        rotate_left(t, p);             // rotate left
+        w = nd(t, p).right;            // update sibling
+      }
+      if (color_of(t, nd(t, w).left) == RBTREE_BLACK && color_of(t, nd(t, w).right) == RBTREE_BLACK) // case 2
+      {
+        set_color(t, w, RBTREE_RED); // recolor sibling
+        x = p;                       // move x up
+      }
+      else
+      {
+        if (color_of(t, nd(t, w).right) == RBTREE_BLACK) // case 3
+        {
+          set_color(t, nd(t, w).left, RBTREE_BLACK); // recolor
+          set_color(t, w, RBTREE_RED);               // recolor
+          rotate_right(t, w);                        // rotate right
+          w = nd(t, p).right;                        // update sibling
+        }
+        set_color(t, w, color_of(t, p));            // case 4
+        set_color(t, p, RBTREE_BLACK);              // recolor
+        set_color(t, nd(t, w).right, RBTREE_BLACK); // recolor
+        rotate_left(t, p);                          // rotate left
+        x = t->root;                                // finish
+      }
+    }
+    else
+    {
+      rbidx_t w = nd(t, p).left;        // sibling
+      if (color_of(t, w) == RBTREE_RED) // case 1 mirror
+      {
+        set_color(t, w, RBTREE_BLACK); // recolor
+        set_color(t, p, RBTREE_RED);   // recolor
+        rotate_right(t, p);            // rotate right
+        w = nd(t, p).left;             // update sibling
+      }
+      if (color_of(t, nd(t, w).right) == RBTREE_BLACK && color_of(t, nd(t, w).left) == RBTREE_BLACK) // case 2 mirror
+      {
+        set_color(t, w, RBTREE_RED); // recolor
+        x = p;                       // move x up
+      }
+      else
+      {
+        if (color_of(t, nd(t, w).left) == RBTREE_BLACK) // case 3 mirror
+        {
+          set_color(t, nd(t, w).right, RBTREE_BLACK); // recolor
+          set_color(t, w, RBTREE_RED);                // recolor
+          rotate_left(t, w);                          // rotate left
+          w = nd(t, p).left;                          // update sibling
+        }
+        set_color(t, w, color_of(t, p));           // case 4 mirror
+        set_color(t, p, RBTREE_BLACK);             // recolor
+        set_color(t, nd(t, w).left, RBTREE_BLACK); // recolor
+        rotate_right(t, p);                        // rotate right
+        x = t->root;                               // finish
+      }
+    }
+  }
+  set_color(t, x, RBTREE_BLACK); // ensure x is black
+}
+
+/* Purpose: Erase the node behind handle h and recycle its slot; returns 1 on success. */
+int rbtree_idx_erase(rbtree_idx *t, const rbidx_t h)
+{
+  if (t == NULL || h == RBIDX_NIL || h >= t->used) // invalid input
+    return 0;                                      // nothing done
+
+  const rbidx_t z = h;                       // node to remove
+  rbidx_t y = z;                             // node actually unlinked
+  rbidx_t x;                                 // child that replaces y
+  color_t y_original_color = color_of(t, y); // save original color
+
+  if (nd(t, z).left == RBIDX_NIL) // no left child
+  {
+    x = nd(t, z).right;               // right child will replace z
+    transplant(t, z, nd(t, z).right); // replace z with its right child
+  }
+  else if (nd(t, z).right == RBIDX_NIL) // no right child
+  {
+    x = nd(t, z).left;               // left child will replace z
+    transplant(t, z, nd(t, z).left); // replace z with its left child
+  }
+  else // both children exist
+  {
+    y = subtree_min(t, nd(t, z).right); // successor is minimum in right subtree
+    y_original_color = color_of(t, y);  // save successor color
+    x = nd(t, y).right;                 // x is successor's right child
+    if (parent_of(t, y) == z)           // successor is direct child
+      set_parent(t, x, y);              // may set the sentinel's parent
+    else
+    {
+      transplant(t, y, nd(t, y).right); // replace successor with its right child
+      nd(t, y).right = nd(t, z).right;  // move z's right subtree under y
+      set_parent(t, nd(t, y).right, y); // fix parent
+    }
+    transplant(t, z, y);             // replace z with successor
+    nd(t, y).left = nd(t, z).left;   // attach z's left subtree to y
+    set_parent(t, nd(t, y).left, y); // fix parent
+    set_color(t, y, color_of(t, z)); // copy color
+  }
+
+  if (y_original_color == RBTREE_BLACK) // removed node was black
+    rebuild_after_delete(t, x);         // restore red-black properties
+
+  nd(t, z).right = t->free_list; // link through right
+  t->free_list = z;              // push the slot for the next insert
+  t->count--;                    // one key less
+  return 1;                      // success
+}
+
+/* Purpose: Copy up to n keys in order into arr; returns how many were copied. */
+int rbtree_idx_to_array(const rbtree_idx *t, key_t *arr, const size_t n)
+{
+  size_t i = 0; // keys written
+  for (rbidx_t h = rbtree_idx_min(t); h != RBIDX_NIL && i < n; h = rbtree_idx_next(t, h))
+    arr[i++] = nd(t, h).key; // in-order copy
+  return (int)i;             // keys written
+}
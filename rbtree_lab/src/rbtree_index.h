@@ -0,0 +1,55 @@
+#ifndef _RBTREE_INDEX_H_
+#define _RBTREE_INDEX_H_
+
+#include "rbtree.h"
+
+#include <stdint.h>
+
+// Index-linked red-black tree: every node lives in one growable array and links are uint32_t
+// indices, so a node with an int key takes 16 bytes instead of 32. Index 0 is the sentinel,
+// playing the part of t->nil. Callers hold handles (indices) rather than node pointers, since
+// growing the array may move it; a handle stays valid until its key is erased.
+// The parent index shares a word with the color bit, so a tree holds at most 2^31 - 1 nodes.
+typedef uint32_t rbidx_t;
+
+#define RBIDX_NIL 0 // sentinel handle, returned where rbtree.h returns NULL
+
+typedef struct
+{
+  key_t key;
+  rbidx_t left, right;
+  uint32_t parent_color; // parent index << 1 | color
+} inode_t;
+
+typedef struct
+{
+  inode_t *nodes;    // nodes[0] is the sentinel
+  rbidx_t root;      // RBIDX_NIL when empty
+  rbidx_t free_list; // erased slots, linked through ->right
+  uint32_t used;     // slots handed out so far, sentinel included
+  uint32_t cap;      // slots allocated
+  size_t count;      // number of keys stored
+} rbtree_idx;
+
+rbtree_idx *new_rbtree_idx(void);
+rbtree_idx *new_rbtree_idx_with_capacity(const size_t);
+void delete_rbtree_idx(rbtree_idx *);
+
+rbidx_t rbtree_idx_insert(rbtree_idx *, const key_t);
+rbidx_t rbtree_idx_find(const rbtree_idx *, const key_t);
+rbidx_t rbtree_idx_min(const rbtree_idx *);
+rbidx_t rbtree_idx_max(const rbtree_idx *);
+rbidx_t rbtree_idx_lower_bound(const rbtree_idx *, const key_t);
+rbidx_t rbtree_idx_next(const rbtree_idx *, const rbidx_t);
+rbidx_t rbtree_idx_prev(const rbtree_idx *, const rbidx_t);
+int rbtree_idx_erase(rbtree_idx *, const rbidx_t);
+
+int rbtree_idx_to_array(const rbtree_idx *, key_t *, const size_t);
+
+/* Purpose: Key stored under handle h (h must not be RBIDX_NIL). */
+static inline key_t rbtree_idx_key(const rbtree_idx *t, const rbidx_t h)
+{
+  return t->nodes[h].key; // array may have moved since h was returned, the index has not
+}
+
+#endif // _RBTREE_INDEX_H_
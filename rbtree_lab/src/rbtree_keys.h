@@ -0,0 +1,13 @@
+#ifndef _RBTREE_KEYS_H_
+#define _RBTREE_KEYS_H_
+
+#include "rbtree_define.h"
+
+#include <stdint.h>
+
+// Ready-made instances of RBTREE_DEFINE for the key types the lab keeps needing.
+RBTREE_DEFINE(rbtree_i64, int64_t, RBTREE_LESS)          // 64-bit ids and timestamps
+RBTREE_DEFINE(rbtree_f64, double, RBTREE_LESS)           // no NaN keys
+RBTREE_DEFINE(rbtree_str, const char *, RBTREE_STR_LESS) // stores the pointer: the caller keeps the string alive
+
+#endif // _RBTREE_KEYS_H_
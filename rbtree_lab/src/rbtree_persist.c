@@ -0,0 +1,338 @@
+#include "rbtree_persist.h"
+
+#include <stdlib.h>
+
+#define is_red(n) ((n) != NULL && (n)->color == RBTREE_RED) // missing children count as black
+
+/* Purpose: Add a reference to n (NULL allowed). */
+static void node_retain(pnode_t *n)
+{
+  if (n != NULL)                                       // empty subtree has no count
+    __atomic_add_fetch(&n->refs, 1, __ATOMIC_RELAXED); // only the updater adds, always from a live link
+}
+
+/* Purpose: Drop one reference to n, freeing it and every descendant no other version shares. */
+static void node_release(pnode_t *n)
+{
+  while (n != NULL && __atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL) == 0) // last reference gone
+  {
+    node_release(n->left);     // recursion depth is bounded by the tree height
+    pnode_t *right = n->right; // read before freeing
+    free(n);                   // node is unreachable now
+    n = right;                 // continue down the right side without recursing
+  }
+}
+
+/* Purpose: Make sure enough nodes are on hand that an update can never fail half way; returns 0 when out of memory. */
+static int reserve(rbtree_persist *p)
+{
+  size_t height = 2;                            // red-black height is below 2 * log2(count + 1) + 2
+  for (size_t c = p->count + 1; c > 1; c >>= 1) // floor(log2(count + 1))
+    height += 2;                                // two levels per doubling
+  const size_t need = 3 * height + 8;           // path, siblings and nephews of one erase, plus a new node
+  while (p->nspare < need)                      // top up what the last update used
+  {
+    pnode_t *n = (pnode_t *)malloc(sizeof(pnode_t)); // fresh node
+    if (n == NULL)                                   // out of memory
+      return 0;                                      // tree is untouched
+    n->right = p->spare;                             // push
+    p->spare = n;                                    // new head
+    p->nspare++;                                     // one more on hand
+  }
+  return 1; // every take_spare of this update succeeds
+}
+
+/* Purpose: Pop a reserved node. */
+static pnode_t *take_spare(rbtree_persist *p)
+{
+  pnode_t *n = p->spare; // reserve() guarantees one
+  p->spare = n->right;   // pop
+  p->nspare--;           // one fewer on hand
+  return n;              // caller fills every field
+}
+
+/* Purpose: Return the node in *slot, first replacing it with a private copy if another version shares it. */
+static pnode_t *unique(rbtree_persist *p, pnode_t **slot)
+{
+  pnode_t *n = *slot;                                     // parent holding slot is already private
+  if (__atomic_load_n(&n->refs, __ATOMIC_ACQUIRE) == 1)   // only the current version reaches n
+    return n;                                             // change in place
+  pnode_t *c = take_spare(p);                             // copy for the current version
+  *c = (pnode_t){n->key, n->color, 1, n->left, n->right}; // referenced by slot only; refs of n is left to atomics
+  node_retain(c->left);                                   // children gain the copy as a parent
+  node_retain(c->right);                                  // children gain the copy as a parent
+  *slot = c;                                              // current version now points at the copy
+  node_release(n);                                        // older versions keep n
+  return c;                                               // safe to modify
+}
+
+/* Purpose: Point the link of above that held old at new (above == NULL: the root). */
+static void relink(rbtree_persist *p, pnode_t *above, const pnode_t *old, pnode_t *new)
+{
+  if (above == NULL)           // old was the root
+    p->root = new;             // new root
+  else if (above->left == old) // old was the left child
+    above->left = new;         // replace left link
+  else                         // old was the right child
+    above->right = new;        // replace right link
+}
+
+/* Purpose: Rotate at x (left: x->right rises, else x->left rises) below above; returns the risen node. */
+static pnode_t *rotate(rbtree_persist *p, pnode_t *above, pnode_t *x, const int left)
+{
+  pnode_t *y = left ? x->right : x->left; // rising child, private like x
+  if (left)                               // rotate left
+  {
+    x->right = y->left; // inner subtree changes parent
+    y->left = x;        // x goes down
+  }
+  else // rotate right
+  {
+    x->left = y->right; // inner subtree changes parent
+    y->right = x;       // x goes down
+  }
+  relink(p, above, x, y); // y takes x's place; every moved node still has exactly one parent here
+  return y;               // new subtree root
+}
+
+/* Purpose: Create an empty persistent tree. */
+rbtree_persist *new_rbtree_persist(void)
+{
+  return (rbtree_persist *)calloc(1, sizeof(rbtree_persist)); // NULL root, no spares
+}
+
+/* Purpose: Drop the current version and the reserve; snapshots taken earlier stay valid until released. */
+void delete_rbtree_persist(rbtree_persist *p)
+{
+  if (p == NULL)         // nothing to do if tree is NULL
+    return;              // early return
+  node_release(p->root); // frees whatever no snapshot still shares
+  while (p->spare != NULL)
+    free(take_spare(p)); // reserve
+  free(p);               // free tree struct
+}
+
+/* Purpose: Insert key into a new current version, copying only shared nodes on its path; returns 0 when out of memory. */
+int rbtree_persist_insert(rbtree_persist *p, const key_t key)
+{
+  if (!reserve(p)) // every copy below is preallocated
+    return 0;      // out of memory, tree unchanged
+
+  pnode_t *path[RBTREE_PERSIST_MAX_DEPTH]; // private nodes from the root down
+  int i = 0;                               // path length
+  pnode_t **slot = &p->root;               // link to follow next
+  while (*slot != NULL)                    // descend as rbtree_insert does
+  {
+    pnode_t *n = unique(p, slot);               // the path is rewritten, so it must be private
+    path[i++] = n;                              // remember instead of a parent pointer
+    slot = key < n->key ? &n->left : &n->right; // duplicates go right
+  }
+  pnode_t *z = take_spare(p);                     // new leaf
+  *z = (pnode_t){key, RBTREE_RED, 1, NULL, NULL}; // red, one parent
+  *slot = z;                                      // link
+  path[i] = z;                                    // bottom of the path
+
+  while (i >= 2 && is_red(path[i - 1])) // red parent under a black grandparent
+  {
+    pnode_t *par = path[i - 1], *g = path[i - 2]; // both private
+    const int dir = par == g->right;              // side of the parent
+    pnode_t **uslot = dir ? &g->left : &g->right; // uncle link
+    if (is_red(*uslot))                           // recolor and move two levels up
+    {
+      unique(p, uslot)->color = RBTREE_BLACK; // uncle may be shared with a snapshot
+      par->color = RBTREE_BLACK;              // parent black
+      g->color = RBTREE_RED;                  // grandparent red
+      i -= 2;                                 // continue from the grandparent
+      continue;
+    }
+    if (path[i] == (dir ? par->left : par->right))  // inner child
+      par = rotate(p, g, par, !dir);                // make it an outer child; it is the parent now
+    par->color = RBTREE_BLACK;                      // new subtree root
+    g->color = RBTREE_RED;                          // goes down
+    rotate(p, i >= 3 ? path[i - 3] : NULL, g, dir); // lift the parent
+    break;                                          // black subtree root: done
+  }
+  p->root->color = RBTREE_BLACK; // root is on the path, so private
+  p->count++;                    // one more key
+  return 1;                      // success
+}
+
+/* Purpose: Restore black heights after a black node was removed from side dir of path[i - 1]; x took its place. */
+static void erase_fixup(rbtree_persist *p, pnode_t **path, int i, pnode_t *x, int dir)
+{
+  while (i > 0 && !is_red(x)) // x's side is one black short
+  {
+    pnode_t *par = path[i - 1];                             // private
+    pnode_t *w = unique(p, dir ? &par->left : &par->right); // sibling is never empty here
+    if (is_red(w))                                          // make the sibling black
+    {
+      w->color = RBTREE_BLACK;                           // sibling rises
+      par->color = RBTREE_RED;                           // parent goes down
+      rotate(p, i >= 2 ? path[i - 2] : NULL, par, !dir); // towards x
+      path[i - 1] = w;                                   // w now sits above the parent
+      path[i++] = par;                                   // path grew by one
+      w = unique(p, dir ? &par->left : &par->right);     // new sibling: w's old inner child, black
+    }
+    if (!is_red(w->left) && !is_red(w->right)) // both nephews black
+    {
+      w->color = RBTREE_RED;                    // sibling side loses a black too
+      x = par;                                  // parent is now short
+      i--;                                      // move up
+      dir = i > 0 && path[i - 1]->right == par; // side of the new x
+      continue;
+    }
+    if (!is_red(dir ? w->left : w->right)) // far nephew black, near nephew red
+    {
+      pnode_t *near = unique(p, dir ? &w->right : &w->left); // will rise
+      near->color = RBTREE_BLACK;                            // becomes the sibling
+      w->color = RBTREE_RED;                                 // goes down
+      w = rotate(p, par, w, dir);                            // away from x
+    }
+    pnode_t *far = unique(p, dir ? &w->left : &w->right); // red far nephew
+    w->color = par->color;                                // sibling takes the parent's place
+    par->color = RBTREE_BLACK;                            // extra black for x's side
+    far->color = RBTREE_BLACK;                            // keeps the far side's height
+    rotate(p, i >= 2 ? path[i - 2] : NULL, par, !dir);    // towards x
+    return;                                               // heights restored
+  }
+  if (x != NULL) // red x absorbs the missing black
+    unique(p, i == 0 ? &p->root : dir ? &path[i - 1]->right : &path[i - 1]->left)->color = RBTREE_BLACK;
+}
+
+/* Purpose: Erase one occurrence of key into a new current version; returns 1 if a key was removed. */
+int rbtree_persist_erase(rbtree_persist *p, const key_t key)
+{
+  if (!rbtree_persist_find(p, key) || !reserve(p)) // absent keys must not copy any path
+    return 0;                                      // nothing removed
+
+  pnode_t *path[RBTREE_PERSIST_MAX_DEPTH]; // private nodes from the root down
+  int i = 0;                               // path length
+  pnode_t **slot = &p->root;               // link to follow next
+  for (;;)                                 // same comparisons as the search above, so it ends at the same node
+  {
+    pnode_t *n = unique(p, slot);               // the path is rewritten, so it must be private
+    path[i++] = n;                              // remember instead of a parent pointer
+    if (n->key == key)                          // found
+      break;                                    // stop
+    slot = key < n->key ? &n->left : &n->right; // descend
+  }
+
+  pnode_t *target = path[i - 1];                     // node holding key
+  int dir = i >= 2 && path[i - 2]->right == target;  // side of the node that is unlinked
+  if (target->left != NULL && target->right != NULL) // two children: unlink the successor instead
+  {
+    slot = &target->right; // successor is the leftmost node on the right
+    dir = 1;               // first step goes right
+    for (;;)
+    {
+      pnode_t *n = unique(p, slot); // its parent link changes
+      path[i++] = n;                // extend the path
+      if (n->left == NULL)          // leftmost
+        break;                      // found the successor
+      slot = &n->left;              // keep going left
+      dir = 0;                      // unlinked from a left link
+    }
+    target->key = path[i - 1]->key; // successor's key moves up
+  }
+
+  pnode_t *y = path[--i];                            // node to unlink, at most one child
+  pnode_t *x = y->left != NULL ? y->left : y->right; // child that takes its place
+  relink(p, i > 0 ? path[i - 1] : NULL, y, x);       // x keeps exactly one parent
+  const color_t removed = y->color;                  // read before recycling
+  y->right = p->spare;                               // private node goes back to the reserve
+  p->spare = y;                                      // push
+  p->nspare++;                                       // one more on hand
+  if (removed == RBTREE_BLACK)                       // black height changed
+    erase_fixup(p, path, i, x, dir);                 // rebalance
+  p->count--;                                        // one fewer key
+  return 1;                                          // removed
+}
+
+/* Purpose: Node holding key in the subtree at n, or NULL. */
+static const pnode_t *search(const pnode_t *n, const key_t key)
+{
+  while (n != NULL && n->key != key)       // stop at key or past a leaf
+    n = key < n->key ? n->left : n->right; // descend
+  return n;                                // NULL if absent
+}
+
+/* Purpose: Whether key is in the current version. */
+int rbtree_persist_find(const rbtree_persist *p, const key_t key)
+{
+  return search(p->root, key) != NULL; // plain descent
+}
+
+/* Purpose: Hand out the current version in O(1); it never changes and must be released. */
+rbtree_snap *rbtree_snapshot(rbtree_persist *p)
+{
+  rbtree_snap *s = (rbtree_snap *)malloc(sizeof(rbtree_snap)); // handle
+  if (s == NULL)                                               // out of memory
+    return NULL;                                               // report failure
+  node_retain(p->root);                                        // next update copies the root instead of changing it
+  s->root = p->root;                                           // shared version
+  s->count = p->count;                                         // size at this version
+  return s;                                                    // immutable from now on
+}
+
+/* Purpose: Drop a snapshot; nodes no other version shares are freed. */
+void rbtree_snap_release(rbtree_snap *s)
+{
+  if (s == NULL)                    // nothing to do if snapshot is NULL
+    return;                         // early return
+  node_release((pnode_t *)s->root); // may free most of an old version
+  free(s);                          // free handle
+}
+
+/* Purpose: Whether key is in the snapshot. */
+int rbtree_snap_find(const rbtree_snap *s, const key_t key)
+{
+  return search(s->root, key) != NULL; // plain descent
+}
+
+/* Purpose: Copy up to n keys of the snapshot in order; returns how many were copied. */
+int rbtree_snap_to_array(const rbtree_snap *s, key_t *arr, const size_t n)
+{
+  rbtree_snap_cursor cur; // explicit stack walk
+  rbtree_snap_first(&cur, s);
+  size_t i = 0;                                    // keys written
+  while (i < n && rbtree_snap_next(&cur, &arr[i])) // stop at n or at the end
+    i++;                                           // next slot
+  return (int)i;                                   // keys written
+}
+
+/* Purpose: Position cur before the smallest key of the snapshot. */
+void rbtree_snap_first(rbtree_snap_cursor *cur, const rbtree_snap *s)
+{
+  cur->depth = 0;                                          // empty stack
+  for (const pnode_t *n = s->root; n != NULL; n = n->left) // left spine
+    cur->stack[cur->depth++] = n;                          // each comes before its right subtree
+}
+
+/* Purpose: Position cur before the first key >= lo in the snapshot. */
+void rbtree_snap_seek(rbtree_snap_cursor *cur, const rbtree_snap *s, const key_t lo)
+{
+  cur->depth = 0;             // empty stack
+  const pnode_t *n = s->root; // start at the root
+  while (n != NULL)           // lower-bound descent
+  {
+    if (n->key >= lo) // n qualifies, smaller ones may be left
+    {
+      cur->stack[cur->depth++] = n; // visit after its left subtree
+      n = n->left;                  // look for a smaller qualifying key
+    }
+    else            // n and its left subtree are below lo
+      n = n->right; // skip them
+  }
+}
+
+/* Purpose: Copy the next key to *out and advance; returns 0 at the end. */
+int rbtree_snap_next(rbtree_snap_cursor *cur, key_t *out)
+{
+  if (cur->depth == 0)                                      // nothing left
+    return 0;                                               // end of the walk
+  const pnode_t *n = cur->stack[--cur->depth];              // smallest pending key
+  *out = n->key;                                            // copy
+  for (const pnode_t *c = n->right; c != NULL; c = c->left) // successors: left spine of the right subtree
+    cur->stack[cur->depth++] = c;                           // pending
+  return 1;                                                 // copied
+}
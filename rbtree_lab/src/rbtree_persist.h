@@ -0,0 +1,60 @@
+#ifndef _RBTREE_PERSIST_H_
+#define _RBTREE_PERSIST_H_
+
+#include "rbtree.h"
+
+// Persistent red-black tree: insert/erase copy only the nodes they change that an older
+// version still shares, so rbtree_snapshot hands out an immutable version in O(1).
+// Nodes carry no parent pointer (one node may sit under parents of several versions);
+// updates keep the root path on an explicit stack and snapshot cursors do the same.
+//
+// Nodes are freed when the last version referencing them goes away. One thread may update a
+// rbtree_persist at a time; snapshots may be read and released from any thread meanwhile.
+typedef struct pnode_t
+{
+  key_t key;
+  color_t color;
+  unsigned refs;                // parent links and version roots pointing here
+  struct pnode_t *left, *right; // NULL: no child
+} pnode_t;
+
+typedef struct
+{
+  pnode_t *root;  // current version, written only by the updating thread
+  size_t count;   // number of keys in the current version
+  pnode_t *spare; // nodes reserved before an update, linked through ->right
+  size_t nspare;  // length of spare
+} rbtree_persist;
+
+typedef struct
+{
+  const pnode_t *root; // holds one reference
+  size_t count;        // number of keys in this version
+} rbtree_snap;
+
+// In-order walk over a snapshot; the stack replaces the parent pointers.
+#define RBTREE_PERSIST_MAX_DEPTH 130 // 2 * log2(SIZE_MAX) plus the path growth of one erase
+
+typedef struct
+{
+  const pnode_t *stack[RBTREE_PERSIST_MAX_DEPTH]; // nodes whose key is still to come, next on top
+  int depth;                                      // entries in stack
+} rbtree_snap_cursor;
+
+rbtree_persist *new_rbtree_persist(void);
+void delete_rbtree_persist(rbtree_persist *);
+
+int rbtree_persist_insert(rbtree_persist *, const key_t);
+int rbtree_persist_erase(rbtree_persist *, const key_t);
+int rbtree_persist_find(const rbtree_persist *, const key_t);
+
+rbtree_snap *rbtree_snapshot(rbtree_persist *);
+void rbtree_snap_release(rbtree_snap *);
+int rbtree_snap_find(const rbtree_snap *, const key_t);
+int rbtree_snap_to_array(const rbtree_snap *, key_t *, const size_t);
+
+void rbtree_snap_first(rbtree_snap_cursor *, const rbtree_snap *);
+void rbtree_snap_seek(rbtree_snap_cursor *, const rbtree_snap *, const key_t);
+int rbtree_snap_next(rbtree_snap_cursor *, key_t *);
+
+#endif // _RBTREE_PERSIST_H_
@@ -0,0 +1,280 @@
+#include "rbtree_shard.h"
+
+#include <stdlib.h>
+
+#ifndef RBTREE_SHARD_SKEW
+#define RBTREE_SHARD_SKEW 2 // a part may grow to this many times its fair share before a rebalance
+#endif
+#ifndef RBTREE_SHARD_MIN_KEYS
+#define RBTREE_SHARD_MIN_KEYS 4096 // small parts are never worth moving
+#endif
+
+#define relaxed_load(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define relaxed_store(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+/* Purpose: Index of the part whose range holds key, from the current bounds. */
+static size_t route(const rbtree_shard *s, const key_t key)
+{
+  size_t lo = 0, hi = s->nparts - 1; // answer lies in [lo, hi]
+  while (lo < hi)                    // binary search over the split keys
+  {
+    const size_t mid = lo + (hi - lo) / 2;  // split key to compare
+    if (key < relaxed_load(s->bounds[mid])) // key belongs left of this split
+      hi = mid;                             // part mid or lower
+    else                                    // key is at or past the split
+      lo = mid + 1;                         // part mid + 1 or higher
+  }
+  return lo; // first part whose upper bound exceeds key
+}
+
+/* Purpose: Lock the part that owns key, shared or exclusive, retrying if a rebalance moved the bounds. */
+static rbtree_shard_part *lock_part(rbtree_shard *s, const key_t key, const int exclusive)
+{
+  for (;;)
+  {
+    const unsigned long version = __atomic_load_n(&s->version, __ATOMIC_ACQUIRE); // bounds this routing reads
+    rbtree_shard_part *p = &s->parts[route(s, key)];                              // candidate part
+    if (exclusive)                                                                // writer
+      pthread_rwlock_wrlock(&p->lock);                                            // alone in this part
+    else                                                                          // reader
+      pthread_rwlock_rdlock(&p->lock);                                            // shared with other readers
+    if (relaxed_load(s->version) == version)                                      // rebalance changes version only while holding every part
+      return p;                                                                   // routing is still valid
+    pthread_rwlock_unlock(&p->lock);                                              // keys moved: route again
+  }
+}
+
+/* Purpose: Largest part size allowed before inserts trigger a rebalance. */
+static size_t next_limit(const size_t total, const size_t nparts, const size_t largest)
+{
+  const size_t fair = total / nparts;                                   // even share
+  const size_t base = largest > fair ? largest : fair;                  // duplicates may keep one part big
+  const size_t limit = RBTREE_SHARD_SKEW * base;                        // allowed growth
+  return limit > RBTREE_SHARD_MIN_KEYS ? limit : RBTREE_SHARD_MIN_KEYS; // floor for small trees
+}
+
+/* Purpose: First index in the sorted array whose key is not below key. */
+static size_t lower_index(const key_t *all, size_t hi, const key_t key)
+{
+  size_t lo = 0;  // answer lies in [lo, hi]
+  while (lo < hi) // binary search
+  {
+    const size_t mid = lo + (hi - lo) / 2; // probe
+    if (all[mid] < key)                    // probe is left of key
+      lo = mid + 1;                        // go right
+    else                                   // probe is key or beyond
+      hi = mid;                            // go left
+  }
+  return lo; // first index >= key
+}
+
+/* Purpose: Recut the parts at key quantiles; every part is write-locked and all holds their keys in order. */
+static size_t redistribute(rbtree_shard *s, const key_t *all, const size_t total)
+{
+  rbtree **fresh = (rbtree **)calloc(s->nparts, sizeof(rbtree *)); // replacement trees
+  size_t *cut = (size_t *)calloc(s->nparts + 1, sizeof(size_t));   // part i takes all[cut[i], cut[i + 1])
+  size_t largest = 0;                                              // biggest new part
+  if (fresh == NULL || cut == NULL)                                // out of memory
+    goto out;                                                      // keep the old layout
+
+  cut[s->nparts] = total; // last part ends at the last key
+  for (size_t i = 1; i < s->nparts; i++)
+    cut[i] = lower_index(all, total, all[i * total / s->nparts]); // equal keys stay together
+  for (size_t i = 0; i < s->nparts; i++)
+  {
+    fresh[i] = rbtree_from_sorted_array(all + cut[i], cut[i + 1] - cut[i]); // O(size) bulk build
+    if (fresh[i] == NULL)                                                   // out of memory
+      goto out;                                                             // keep the old layout
+  }
+
+  for (size_t i = 0; i < s->nparts; i++)
+  {
+    delete_rbtree(s->parts[i].tree); // old tree is no longer reachable
+    s->parts[i].tree = fresh[i];     // install
+    fresh[i] = NULL;                 // owned by the part now
+    if (cut[i + 1] - cut[i] > largest)
+      largest = cut[i + 1] - cut[i]; // track for the next limit
+  }
+  for (size_t i = 1; i < s->nparts; i++)
+    relaxed_store(s->bounds[i - 1], all[cut[i]]);                  // new split keys
+  __atomic_store_n(&s->version, s->version + 1, __ATOMIC_RELEASE); // after the bounds: routers retry
+out:
+  if (fresh != NULL)
+    for (size_t i = 0; i < s->nparts; i++)
+      delete_rbtree(fresh[i]); // only leftovers from a failed build
+  free(fresh);                 // release scratch
+  free(cut);                   // release scratch
+  return largest;              // 0 if nothing moved
+}
+
+/* Purpose: Move keys between parts so each holds about total / nparts; unless forced, only if one outgrew the limit. */
+static void rebalance(rbtree_shard *s, const int force)
+{
+  pthread_mutex_lock(&s->rebalance_lock); // one rebalance at a time
+  for (size_t i = 0; i < s->nparts; i++)
+    pthread_rwlock_wrlock(&s->parts[i].lock); // ascending order, like to_array
+
+  size_t total = 0, largest = 0; // current sizes
+  for (size_t i = 0; i < s->nparts; i++)
+  {
+    const size_t c = s->parts[i].tree->count; // keys in part i
+    total += c;                               // sum
+    if (c > largest)                          // biggest part
+      largest = c;                            // remember
+  }
+
+  if (s->nparts > 1 && total > 0 && (force || largest > s->rebalance_limit)) // skewed, or asked to
+  {
+    key_t *all = (key_t *)malloc(total * sizeof(key_t)); // parts concatenate in key order
+    if (all != NULL)                                     // otherwise keep the old layout
+    {
+      size_t at = 0; // keys gathered so far
+      for (size_t i = 0; i < s->nparts; i++)
+        at += rbtree_to_array(s->parts[i].tree, all + at, total - at); // append part i
+      const size_t moved = redistribute(s, all, at);                   // recut at quantiles
+      if (moved > 0)                                                   // new layout installed
+        largest = moved;                                               // size to grow from
+      free(all);                                                       // release scratch
+    }
+  }
+  relaxed_store(s->rebalance_limit, next_limit(total, s->nparts, largest)); // also stops retrying a failed move
+
+  for (size_t i = s->nparts; i-- > 0;)
+    pthread_rwlock_unlock(&s->parts[i].lock); // release
+  pthread_mutex_unlock(&s->rebalance_lock);   // next rebalance may start
+}
+
+/* Purpose: Create nparts empty parts whose initial bounds split [lo, hi] evenly. */
+rbtree_shard *new_rbtree_shard(const size_t nparts, const key_t lo, const key_t hi)
+{
+  rbtree_shard *s = (rbtree_shard *)calloc(1, sizeof(rbtree_shard)); // allocate container
+  if (s == NULL)                                                     // out of memory
+    return NULL;                                                     // report failure
+  pthread_mutex_init(&s->rebalance_lock, NULL);                      // unlocked
+  s->nparts = nparts > 0 ? nparts : 1;                               // at least one part
+  s->parts = (rbtree_shard_part *)calloc(s->nparts, sizeof(rbtree_shard_part));
+  s->bounds = (key_t *)calloc(s->nparts, sizeof(key_t)); // nparts - 1 used, never a zero-size calloc
+  if (s->parts == NULL || s->bounds == NULL)             // out of memory
+  {
+    delete_rbtree_shard(s); // release what was allocated
+    return NULL;            // report failure
+  }
+  for (size_t i = 1; i < s->nparts; i++)
+    s->bounds[i - 1] = lo + (key_t)((long long)(hi - lo) * (long long)i / (long long)s->nparts); // even split
+  for (size_t i = 0; i < s->nparts; i++)
+  {
+    s->parts[i].tree = new_rbtree(); // empty part
+    if (s->parts[i].tree == NULL)    // out of memory
+    {
+      delete_rbtree_shard(s); // release what was allocated
+      return NULL;            // report failure
+    }
+    pthread_rwlock_init(&s->parts[i].lock, NULL); // unlocked
+  }
+  s->rebalance_limit = next_limit(0, s->nparts, 0); // minimum until keys arrive
+  return s;                                         // ready for any thread
+}
+
+/* Purpose: Destroy the container and every part; no other thread may still use it. */
+void delete_rbtree_shard(rbtree_shard *s)
+{
+  if (s == NULL) // nothing to do if container is NULL
+    return;      // early return
+  if (s->parts != NULL)
+    for (size_t i = 0; i < s->nparts && s->parts[i].tree != NULL; i++) // parts are set up in order
+    {
+      delete_rbtree(s->parts[i].tree);           // free tree
+      pthread_rwlock_destroy(&s->parts[i].lock); // free lock
+    }
+  pthread_mutex_destroy(&s->rebalance_lock); // free lock
+  free(s->parts);                            // free part array
+  free(s->bounds);                           // free split keys
+  free(s);                                   // free container
+}
+
+/* Purpose: Insert key into its part under that part's write lock; returns 1 on success. */
+int rbtree_shard_insert(rbtree_shard *s, const key_t key)
+{
+  rbtree_shard_part *p = lock_part(s, key, 1);                          // exclusive on one range only
+  const int ok = rbtree_insert(p->tree, key) != NULL;                   // insert
+  const int skewed = p->tree->count > relaxed_load(s->rebalance_limit); // part outgrew its share
+  pthread_rwlock_unlock(&p->lock);                                      // release before rebalancing
+  if (skewed)                                                           // rare: distribution shifted
+    rebalance(s, 0);                                                    // rechecks under every lock
+  return ok;                                                            // 0 only when out of memory
+}
+
+/* Purpose: Erase one occurrence of key under its part's write lock; returns 1 if a node was removed. */
+int rbtree_shard_erase(rbtree_shard *s, const key_t key)
+{
+  rbtree_shard_part *p = lock_part(s, key, 1);                     // exclusive on one range only
+  const int ok = rbtree_erase(p->tree, rbtree_find(p->tree, key)); // find and erase in one critical section
+  pthread_rwlock_unlock(&p->lock);                                 // release
+  return ok;                                                       // 0 if key was absent
+}
+
+/* Purpose: Whether key is present, under its part's read lock. */
+int rbtree_shard_find(rbtree_shard *s, const key_t key)
+{
+  rbtree_shard_part *p = lock_part(s, key, 0);         // shared with other readers
+  const int found = rbtree_find(p->tree, key) != NULL; // lookup
+  pthread_rwlock_unlock(&p->lock);                     // release
+  return found;                                        // 1 if present
+}
+
+/* Purpose: Copy the smallest (right == 0) or largest (right == 1) key; returns 0 if every part is empty. */
+static int extreme(rbtree_shard *s, const int right, key_t *out)
+{
+  for (;;)
+  {
+    const unsigned long version = __atomic_load_n(&s->version, __ATOMIC_ACQUIRE); // layout this scan reads
+    int found = 0;                                                                // no key yet
+    for (size_t n = 0; n < s->nparts && !found; n++)
+    {
+      rbtree_shard_part *p = &s->parts[right ? s->nparts - 1 - n : n];     // from the outer end inwards
+      pthread_rwlock_rdlock(&p->lock);                                     // shared with other readers
+      const node_t *e = right ? rbtree_max(p->tree) : rbtree_min(p->tree); // extreme of this part
+      if (e != p->tree->nil)                                               // part is not empty
+      {
+        *out = e->key; // copy while still locked
+        found = 1;     // stop at the first non-empty part
+      }
+      pthread_rwlock_unlock(&p->lock); // release
+    }
+    if (__atomic_load_n(&s->version, __ATOMIC_ACQUIRE) == version) // no keys moved between parts meanwhile
+      return found;                                                // consistent answer
+  }
+}
+
+/* Purpose: Copy the smallest key to *out; returns 0 if the container is empty. */
+int rbtree_shard_min(rbtree_shard *s, key_t *out)
+{
+  return extreme(s, 0, out); // first non-empty part from the left
+}
+
+/* Purpose: Copy the largest key to *out; returns 0 if the container is empty. */
+int rbtree_shard_max(rbtree_shard *s, key_t *out)
+{
+  return extreme(s, 1, out); // first non-empty part from the right
+}
+
+/* Purpose: Copy up to n keys in global order from one consistent snapshot; returns how many were copied. */
+int rbtree_shard_to_array(rbtree_shard *s, key_t *arr, const size_t n)
+{
+  for (size_t i = 0; i < s->nparts; i++)
+    pthread_rwlock_rdlock(&s->parts[i].lock); // ascending order, like rebalance
+
+  size_t copied = 0; // keys written so far
+  for (size_t i = 0; i < s->nparts && copied < n; i++)
+    copied += rbtree_to_array(s->parts[i].tree, arr + copied, n - copied); // parts are already in key order
+
+  for (size_t i = s->nparts; i-- > 0;)
+    pthread_rwlock_unlock(&s->parts[i].lock); // release
+  return (int)copied;                         // keys written
+}
+
+/* Purpose: Recut every part to an even share of the current keys, whatever the skew. */
+void rbtree_shard_rebalance(rbtree_shard *s)
+{
+  rebalance(s, 1); // forced
+}
@@ -0,0 +1,39 @@
+#ifndef _RBTREE_SHARD_H_
+#define _RBTREE_SHARD_H_
+
+#include "rbtree.h"
+
+#include <pthread.h>
+
+// Key-range sharded container: N independent trees, each behind its own reader-writer lock.
+// Part i holds the keys in [bounds[i - 1], bounds[i]), so writers to different ranges never
+// touch the same lock or the same root. Like rbtree_sync it passes keys, not node pointers.
+typedef struct
+{
+  pthread_rwlock_t lock; // guards tree
+  rbtree *tree;          // keys of this range
+  char pad[64];          // keep neighbouring parts off each other's cache lines
+} rbtree_shard_part;
+
+typedef struct
+{
+  size_t nparts;                  // number of parts, fixed at creation
+  rbtree_shard_part *parts;       // nparts parts in key order
+  key_t *bounds;                  // nparts - 1 split keys, ascending
+  unsigned long version;          // bumped by rebalance after it moved the bounds
+  size_t rebalance_limit;         // a part growing past this many keys triggers a rebalance
+  pthread_mutex_t rebalance_lock; // one rebalance at a time
+} rbtree_shard;
+
+rbtree_shard *new_rbtree_shard(const size_t, const key_t, const key_t);
+void delete_rbtree_shard(rbtree_shard *);
+
+int rbtree_shard_insert(rbtree_shard *, const key_t);
+int rbtree_shard_erase(rbtree_shard *, const key_t);
+int rbtree_shard_find(rbtree_shard *, const key_t);
+int rbtree_shard_min(rbtree_shard *, key_t *);
+int rbtree_shard_max(rbtree_shard *, key_t *);
+int rbtree_shard_to_array(rbtree_shard *, key_t *, const size_t);
+void rbtree_shard_rebalance(rbtree_shard *);
+
+#endif // _RBTREE_SHARD_H_
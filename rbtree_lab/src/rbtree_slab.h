@@ -0,0 +1,116 @@
+#ifndef _RBTREE_SLAB_H_
+#define _RBTREE_SLAB_H_
+
+#include "rbtree.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal to the pointer-based engines (rbtree.c, rbtree_topdown.c): the per-tree slab behind an
+// rbtree_slab. Nodes are carved front to back from chunks that double in size up to a cap, erased
+// nodes go on a free list threaded through one of their own child pointers, and the whole slab is
+// freed chunk by chunk without visiting nodes. Each engine describes its node type once with an
+// rbtree_slab_kind and wraps these in its own node_alloc/node_free.
+
+/* Slab chunk: a small header, then `cap` nodes starting at the first address aligned for the node type. */
+struct rbtree_slab_chunk
+{
+  struct rbtree_slab_chunk *next; // next (older) chunk owned by the same tree
+  size_t cap;                     // number of nodes in this chunk
+  char *nodes;                    // node storage, just past the header
+};
+
+typedef struct
+{
+  size_t size;      // sizeof the node type
+  size_t align;     // _Alignof the node type
+  size_t link;      // offset of the child pointer that links free nodes
+  size_t first_cap; // nodes in the first chunk when no capacity is requested
+  size_t max_cap;   // chunks double up to this many nodes
+} rbtree_slab_kind;
+
+/* Purpose: Push a fresh chunk of `cap` zeroed nodes to the slab; returns 0 on allocation failure. */
+static inline int slab_grow(rbtree_slab *s, const rbtree_slab_kind *k, const size_t cap)
+{
+  // zeroed, so a node's links only ever hold NULL, the sentinel or another node of the slab (see rbtree_sync.c);
+  // calloc rather than aligned_alloc + memset, so a large chunk's untouched pages stay free zero pages
+  char *block = (char *)calloc(1, sizeof(struct rbtree_slab_chunk) + k->align - 1 + cap * k->size);
+  if (block == NULL)                                               // out of memory
+    return 0;                                                      // caller reports failure
+  struct rbtree_slab_chunk *c = (struct rbtree_slab_chunk *)block; // header at the start of the block
+  char *after = block + sizeof(*c);                                // nodes go past the header
+  c->nodes = after + (-(uintptr_t)after & (k->align - 1));         // first aligned address
+  c->next = s->chunks;                                             // link in front: the newest chunk is carved first
+  c->cap = cap;                                                    // remember chunk size
+  s->chunks = c;                                                   // attach to slab
+  s->chunk_left = cap;                                             // every node of the new chunk is available
+  return 1;                                                        // success
+}
+
+/* Purpose: Size of the next chunk: double the newest one so a tree of n nodes needs O(log n) chunks. */
+static inline size_t slab_next_cap(const rbtree_slab *s, const rbtree_slab_kind *k)
+{
+  if (s->chunks == NULL)            // first chunk
+    return k->first_cap;            // start small
+  if (s->chunks->cap >= k->max_cap) // already at the cap
+    return k->max_cap;              // stop doubling
+  return s->chunks->cap * 2;        // geometric growth
+}
+
+/* Purpose: Get storage for one node: recycled node first, then the current chunk, then a new chunk. */
+static inline void *slab_alloc(rbtree_slab *s, const rbtree_slab_kind *k)
+{
+  char *n = (char *)s->free_list; // try the free list first
+  if (n != NULL)
+  {
+    memcpy(&s->free_list, n + k->link, sizeof(void *)); // pop recycled node
+    return n;                                           // reuse it
+  }
+  if (s->chunk_left == 0 && !slab_grow(s, k, slab_next_cap(s, k)))        // current chunk exhausted
+    return NULL;                                                          // out of memory
+  return s->chunks->nodes + (s->chunks->cap - s->chunk_left--) * k->size; // carve next node in address order
+}
+
+/* Purpose: Give a node back to the slab it was allocated from. */
+static inline void slab_free(rbtree_slab *s, const rbtree_slab_kind *k, void *n)
+{
+  memcpy((char *)n + k->link, &s->free_list, sizeof(void *)); // link through the child pointer
+  s->free_list = n;                                           // push on free list for the next insert
+}
+
+/* Purpose: Release every chunk of the slab at once, without visiting nodes. */
+static inline void slab_release(rbtree_slab *s)
+{
+  struct rbtree_slab_chunk *c = s->chunks; // start from newest chunk
+  while (c != NULL)                        // walk the chunk list
+  {
+    struct rbtree_slab_chunk *next = c->next; // save link before freeing
+    free(c);                                  // drop whole chunk
+    c = next;                                 // advance
+  }
+  s->chunks = NULL;    // slab is empty
+  s->free_list = NULL; // recycled nodes lived in the chunks
+  s->chunk_left = 0;   // nothing left to carve
+}
+
+/* Purpose: Forget every node but keep the largest chunk, all of it free to carve again. */
+static inline void slab_reset(rbtree_slab *s)
+{
+  struct rbtree_slab_chunk **link = &s->chunks;                                // link to the largest chunk seen so far
+  for (struct rbtree_slab_chunk **c = &s->chunks; *c != NULL; c = &(*c)->next) // not always the newest: a requested
+    if ((*c)->cap > (*link)->cap)                                              // capacity above the cap makes the
+      link = c;                                                                // first chunk the largest
+  struct rbtree_slab_chunk *keep = *link;                                      // chunk to keep
+  if (keep != NULL)
+    *link = keep->next; // detach it from the other chunks
+  slab_release(s);      // drop the other chunks wholesale
+  if (keep != NULL)
+  {
+    keep->next = NULL;         // it becomes the only chunk
+    s->chunks = keep;          // reattach the kept chunk
+    s->chunk_left = keep->cap; // all of it can be carved again
+  }
+}
+
+#endif // _RBTREE_SLAB_H_
@@ -0,0 +1,220 @@
+#include "rbtree_sync.h"
+
+#include <stdlib.h>
+
+#ifdef RBTREE_SYNC_MUTEX
+#define lock_init(l) pthread_mutex_init((l), NULL)
+#define lock_destroy(l) pthread_mutex_destroy(l)
+#define read_lock(l) pthread_mutex_lock(l)
+#define write_lock(l) pthread_mutex_lock(l)
+#define unlock(l) pthread_mutex_unlock(l)
+#else
+#define lock_init(l) pthread_rwlock_init((l), NULL)
+#define lock_destroy(l) pthread_rwlock_destroy(l)
+#define read_lock(l) pthread_rwlock_rdlock(l)
+#define write_lock(l) pthread_rwlock_wrlock(l)
+#define unlock(l) pthread_rwlock_unlock(l)
+#endif
+
+#if !defined(RBTREE_SYNC_MUTEX) && !defined(RBTREE_SYNC_NO_OPTIMISTIC) && !defined(RBTREE_CALLOC_NODES)
+#define OPTIMISTIC_READS // calloc'd nodes go back to malloc on erase, so lock-free readers need the slab
+
+#define OPTIMISTIC_TRIES 8   // failed validations before falling back to the read lock
+#define OPTIMISTIC_DEPTH 128 // longer paths can only come from reading a tree mid-change
+
+#define relaxed_load(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#endif
+
+/* Purpose: Take the write lock and mark the tree as changing for optimistic readers. */
+static void write_begin(rbtree_sync *s)
+{
+  write_lock(&s->lock); // exclusive among writers and locking readers
+#ifdef OPTIMISTIC_READS
+  __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED); // odd: change in progress
+  __atomic_thread_fence(__ATOMIC_RELEASE);                 // seq is visible before any node store
+#endif
+}
+
+/* Purpose: Publish the change to optimistic readers and release the write lock. */
+static void write_end(rbtree_sync *s)
+{
+#ifdef OPTIMISTIC_READS
+  __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE); // even again, after every node store
+#endif
+  unlock(&s->lock); // release
+}
+
+#ifdef OPTIMISTIC_READS
+/* Purpose: Start an optimistic read; returns 0 while a writer is inside. */
+static int read_begin(rbtree_sync *s, unsigned long *seq)
+{
+  *seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE); // pairs with the release in write_end
+  return (*seq & 1) == 0;                            // odd: tree is changing
+}
+
+/* Purpose: Whether nothing was written since read_begin returned seq. */
+static int read_validate(rbtree_sync *s, const unsigned long seq)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);                  // node loads happen before the recheck
+  return __atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq; // unchanged: every load saw one version
+}
+
+/* Purpose: Lock-free lookup; returns 1 and sets *found when a consistent answer was read. */
+static int optimistic_find(rbtree_sync *s, const key_t key, int *found)
+{
+  const rbtree *t = s->tree; // tree struct and sentinel never move
+  for (int tries = 0; tries < OPTIMISTIC_TRIES; tries++)
+  {
+    unsigned long seq;                                                   // version this attempt reads
+    if (!read_begin(s, &seq))                                            // writer inside
+      continue;                                                          // try again
+    node_t *curr = relaxed_load(t->root);                                // start from root
+    int depth = 0, hit = 0;                                              // path length, result
+    while (curr != NULL && curr != t->nil && depth++ < OPTIMISTIC_DEPTH) // NULL: link of a recycled node
+    {
+      const key_t k = relaxed_load(curr->key); // may be stale: validated below
+      if (key == k)                            // found
+      {
+        hit = 1; // remember
+        break;   // stop descending
+      }
+      node_t *left = relaxed_load(curr->left);   // load both links so the choice compiles to a cmov:
+      node_t *right = relaxed_load(curr->right); // a branch on random keys mispredicts half the time
+      curr = key < k ? left : right;             // move down
+    }
+    if (curr != NULL && depth <= OPTIMISTIC_DEPTH && read_validate(s, seq)) // consistent walk
+    {
+      *found = hit; // answer
+      return 1;     // done without locking
+    }
+  }
+  return 0; // too much write traffic: caller locks
+}
+
+/* Purpose: Lock-free min (right == 0) or max (right == 1) from the tree's cached extremes; returns 1 once a consistent answer was read. */
+static int optimistic_extreme(rbtree_sync *s, const int right, key_t *out, int *found)
+{
+  const rbtree *t = s->tree; // tree struct and sentinel never move
+  for (int tries = 0; tries < OPTIMISTIC_TRIES; tries++)
+  {
+    unsigned long seq;                                               // version this attempt reads
+    if (!read_begin(s, &seq))                                        // writer inside
+      continue;                                                      // try again
+    node_t *e = right ? relaxed_load(t->max) : relaxed_load(t->min); // cached extreme, nil if empty
+    const key_t key = e != t->nil ? relaxed_load(e->key) : 0;        // read before validating
+    if (read_validate(s, seq))                                       // no writer moved it meanwhile
+    {
+      *found = e != t->nil; // empty tree has no extreme
+      *out = key;           // only meaningful when found
+      return 1;             // done without locking
+    }
+  }
+  return 0; // too much write traffic: caller locks
+}
+#endif
+
+/* Purpose: Create an empty thread-safe tree. */
+rbtree_sync *new_rbtree_sync(void)
+{
+  rbtree_sync *s = (rbtree_sync *)calloc(1, sizeof(rbtree_sync)); // allocate wrapper
+  if (s == NULL)                                                  // out of memory
+    return NULL;                                                  // report failure
+  s->tree = new_rbtree();                                         // wrapped tree
+  lock_init(&s->lock);                                            // unlocked
+  return s;                                                       // ready for any thread
+}
+
+/* Purpose: Destroy the wrapper and its tree; no other thread may still use it. */
+void delete_rbtree_sync(rbtree_sync *s)
+{
+  if (s == NULL)          // nothing to do if wrapper is NULL
+    return;               // early return
+  delete_rbtree(s->tree); // free tree
+  lock_destroy(&s->lock); // free lock
+  free(s);                // free wrapper
+}
+
+/* Purpose: Insert key under the write lock; returns 1 on success. */
+int rbtree_sync_insert(rbtree_sync *s, const key_t key)
+{
+  write_begin(s);                                     // exclusive
+  const int ok = rbtree_insert(s->tree, key) != NULL; // insert
+  write_end(s);                                       // release
+  return ok;                                          // 0 only when out of memory
+}
+
+/* Purpose: Erase one occurrence of key under the write lock; returns 1 if a node was removed. */
+int rbtree_sync_erase(rbtree_sync *s, const key_t key)
+{
+  write_begin(s);                                                  // exclusive
+  const int ok = rbtree_erase(s->tree, rbtree_find(s->tree, key)); // find and erase in one critical section
+  write_end(s);                                                    // release
+  return ok;                                                       // 0 if key was absent
+}
+
+/* Purpose: Whether key is present, under the shared read lock. */
+int rbtree_sync_find(rbtree_sync *s, const key_t key)
+{
+#ifdef OPTIMISTIC_READS
+  int hit;                           // optimistic answer
+  if (optimistic_find(s, key, &hit)) // consistent without locking
+    return hit;                      // common case
+#endif
+  read_lock(&s->lock);                                 // shared with other readers
+  const int found = rbtree_find(s->tree, key) != NULL; // lookup
+  unlock(&s->lock);                                    // release
+  return found;                                        // 1 if present
+}
+
+/* Purpose: Copy the smallest key to *out under the read lock; returns 0 if the tree is empty. */
+int rbtree_sync_min(rbtree_sync *s, key_t *out)
+{
+#ifdef OPTIMISTIC_READS
+  key_t key;                                // optimistic answer
+  int hit;                                  // whether the tree had a key
+  if (optimistic_extreme(s, 0, &key, &hit)) // consistent without locking
+  {
+    if (hit)      // tree was not empty
+      *out = key; // copy result
+    return hit;   // common case
+  }
+#endif
+  read_lock(&s->lock);                   // shared with other readers
+  const node_t *p = rbtree_min(s->tree); // smallest node (nil if empty)
+  const int found = p != s->tree->nil;   // empty tree returns the sentinel
+  if (found)                             // copy while still locked
+    *out = p->key;                       // node may be erased once unlocked
+  unlock(&s->lock);                      // release
+  return found;                          // 1 if a key was copied
+}
+
+/* Purpose: Copy the largest key to *out under the read lock; returns 0 if the tree is empty. */
+int rbtree_sync_max(rbtree_sync *s, key_t *out)
+{
+#ifdef OPTIMISTIC_READS
+  key_t key;                                // optimistic answer
+  int hit;                                  // whether the tree had a key
+  if (optimistic_extreme(s, 1, &key, &hit)) // consistent without locking
+  {
+    if (hit)      // tree was not empty
+      *out = key; // copy result
+    return hit;   // common case
+  }
+#endif
+  read_lock(&s->lock);                   // shared with other readers
+  const node_t *p = rbtree_max(s->tree); // largest node (nil if empty)
+  const int found = p != s->tree->nil;   // empty tree returns the sentinel
+  if (found)                             // copy while still locked
+    *out = p->key;                       // node may be erased once unlocked
+  unlock(&s->lock);                      // release
+  return found;                          // 1 if a key was copied
+}
+
+/* Purpose: Copy up to n keys in order under the read lock; returns how many were copied. */
+int rbtree_sync_to_array(rbtree_sync *s, key_t *arr, const size_t n)
+{
+  read_lock(&s->lock);                                 // consistent snapshot for the copy
+  const int copied = rbtree_to_array(s->tree, arr, n); // fill array
+  unlock(&s->lock);                                    // release
+  return copied;                                       // keys written
+}
@@ -0,0 +1,36 @@
+#ifndef _RBTREE_SYNC_H_
+#define _RBTREE_SYNC_H_
+
+#include "rbtree.h"
+
+#include <pthread.h>
+
+// Thread-safe wrapper: lookups share a reader-writer lock, mutations hold it exclusively.
+// Node pointers are not handed out, since another thread may erase the node right after the lock is released.
+//
+// find/min/max first try an optimistic read that takes no lock: writers make `seq` odd while they
+// change the tree, and a reader retries when seq moved under it. Erased nodes stay in the tree's
+// slab until delete_rbtree_sync, so a reader racing with erase still reads node memory.
+// Build with -DRBTREE_SYNC_NO_OPTIMISTIC to always lock (implied by RBTREE_SYNC_MUTEX and RBTREE_CALLOC_NODES).
+typedef struct
+{
+#ifdef RBTREE_SYNC_MUTEX
+  pthread_mutex_t lock; // baseline: one global mutex for every call
+#else
+  pthread_rwlock_t lock; // readers in parallel, writers alone
+#endif
+  unsigned long seq; // even: tree stable, odd: a writer is inside
+  rbtree *tree;      // wrapped tree, written only under the write lock
+} rbtree_sync;
+
+rbtree_sync *new_rbtree_sync(void);
+void delete_rbtree_sync(rbtree_sync *);
+
+int rbtree_sync_insert(rbtree_sync *, const key_t);
+int rbtree_sync_erase(rbtree_sync *, const key_t);
+int rbtree_sync_find(rbtree_sync *, const key_t);
+int rbtree_sync_min(rbtree_sync *, key_t *);
+int rbtree_sync_max(rbtree_sync *, key_t *);
+int rbtree_sync_to_array(rbtree_sync *, key_t *, const size_t);
+
+#endif // _RBTREE_SYNC_H_
@@ -0,0 +1,236 @@
+#include "rbtree_topdown.h"
+#include "rbtree_slab.h"
+
+#include <stdlib.h>
+
+#ifndef RBTREE_TD_CHUNK_NODES
+#define RBTREE_TD_CHUNK_NODES 1024 // nodes in the first slab chunk
+#endif
+
+#ifndef RBTREE_TD_CHUNK_NODES_MAX
+#define RBTREE_TD_CHUNK_NODES_MAX (1u << 22) // chunks double up to this many nodes (~100MB)
+#endif
+
+#define TD_MAX_DEPTH 128 // red-black height is at most 2 * log2(count + 1)
+
+#define is_red(n) ((n) != NULL && (n)->color == RBTREE_RED) // missing children count as black
+
+// tdnode_t as the slab sees it: no parent pointer, so free nodes are linked through link[1]
+static const rbtree_slab_kind node_kind = {sizeof(tdnode_t), _Alignof(tdnode_t), offsetof(tdnode_t, link[1]),
+                                           RBTREE_TD_CHUNK_NODES, RBTREE_TD_CHUNK_NODES_MAX};
+
+/* Purpose: Create an empty tree; its first chunk is allocated by the first insert. */
+rbtree_td *new_rbtree_td(void)
+{
+  return (rbtree_td *)calloc(1, sizeof(rbtree_td)); // NULL root, no chunks
+}
+
+/* Purpose: Free every chunk and the tree; no node is visited. */
+void delete_rbtree_td(rbtree_td *t)
+{
+  if (t == NULL)          // nothing to do if tree is NULL
+    return;               // early return
+  slab_release(&t->slab); // drop the chunks
+  free(t);                // free tree struct
+}
+
+/* Purpose: Rotate root's child on side !dir up in its place, making it black and root red; returns the new root. */
+static tdnode_t *rotate(tdnode_t *root, const int dir)
+{
+  tdnode_t *save = root->link[!dir];  // child that comes up
+  root->link[!dir] = save->link[dir]; // its inner subtree changes sides
+  save->link[dir] = root;             // root goes down on the dir side
+  root->color = RBTREE_RED;           // demoted node turns red
+  save->color = RBTREE_BLACK;         // promoted node turns black
+  return save;                        // caller links it where root was
+}
+
+/* Purpose: Rotate root's child on side !dir the other way first, then rotate it up; returns the new root. */
+static tdnode_t *rotate_twice(tdnode_t *root, const int dir)
+{
+  root->link[!dir] = rotate(root->link[!dir], !dir); // straighten the zig-zag
+  return rotate(root, dir);                          // then a single rotation
+}
+
+/* Purpose: Insert a key in one pass from the root; returns its node (valid until the next erase) or NULL when out of memory. */
+tdnode_t *rbtree_td_insert(rbtree_td *t, const key_t key)
+{
+  tdnode_t *n = slab_alloc(&t->slab, &node_kind); // allocated up front: the descent changes the tree as it goes
+  if (n == NULL)                                  // out of memory
+    return NULL;                                  // nothing inserted
+  n->link[0] = n->link[1] = NULL;                 // new leaf
+  n->key = key;                                   // store key
+  n->color = RBTREE_RED;                          // new nodes are red
+
+  if (t->root == NULL) // empty tree
+    t->root = n;       // new node is root
+  else
+  {
+    tdnode_t head = {{NULL, t->root}, 0, RBTREE_BLACK}; // false root: rotations at the top need no special case
+    tdnode_t *gg = &head;                               // great-grandparent
+    tdnode_t *g = NULL, *p = NULL;                      // grandparent and parent
+    tdnode_t *q = t->root;                              // current node
+    int dir = 0, last = 0;                              // side taken into q, and into p
+    for (;;)
+    {
+      if (q == NULL)                                     // fell off the tree
+        p->link[dir] = q = n;                            // hang the new node here
+      else if (is_red(q->link[0]) && is_red(q->link[1])) // split a 4-node on the way down
+      {
+        q->color = RBTREE_RED;            // push the red up
+        q->link[0]->color = RBTREE_BLACK; // children turn black
+        q->link[1]->color = RBTREE_BLACK; // so q's black height is unchanged
+      }
+      if (is_red(q) && is_red(p)) // red violation between q and p: rotate at g, which is black
+      {
+        const int dir2 = gg->link[1] == g;                            // side g hangs from
+        gg->link[dir2] = q == p->link[last] ? rotate(g, !last)        // straight line
+                                            : rotate_twice(g, !last); // zig-zag
+      }
+      if (q == n)            // new node is linked and every violation above it is fixed
+        break;               // done: nothing to do on the way back up
+      last = dir;            // side taken into q
+      dir = !(key < q->key); // duplicates go right
+      if (g != NULL)         // keep the window four nodes tall
+        gg = g;              // slide down
+      g = p;                 // slide down
+      p = q;                 // slide down
+      q = q->link[dir];      // next node
+    }
+    t->root = head.link[1]; // the top may have rotated
+  }
+  t->root->color = RBTREE_BLACK; // ensure root is black
+  t->count++;                    // one more key
+  return n;                      // a single pass keeps keys in their nodes
+}
+
+/* Purpose: Return a node holding key (valid until the next erase), or NULL. */
+tdnode_t *rbtree_td_find(const rbtree_td *t, const key_t key)
+{
+  tdnode_t *curr = t->root; // start from root
+  while (curr != NULL)      // traverse until a missing child
+  {
+    if (key == curr->key)                  // found
+      return curr;                         // return node
+    curr = curr->link[!(key < curr->key)]; // descend
+  }
+  return NULL; // not found
+}
+
+/* Purpose: Return the node with the smallest key, or NULL if the tree is empty. */
+tdnode_t *rbtree_td_min(const rbtree_td *t)
+{
+  tdnode_t *curr = t->root;                     // start from root
+  while (curr != NULL && curr->link[0] != NULL) // traverse left
+    curr = curr->link[0];                       // move left
+  return curr;                                  // leftmost or NULL
+}
+
+/* Purpose: Return the node with the largest key, or NULL if the tree is empty. */
+tdnode_t *rbtree_td_max(const rbtree_td *t)
+{
+  tdnode_t *curr = t->root;                     // start from root
+  while (curr != NULL && curr->link[1] != NULL) // traverse right
+    curr = curr->link[1];                       // move right
+  return curr;                                  // rightmost or NULL
+}
+
+/* Purpose: Return the first node (in order) with key >= key, or NULL if every key is smaller. */
+tdnode_t *rbtree_td_lower_bound(const rbtree_td *t, const key_t key)
+{
+  tdnode_t *best = NULL;    // best candidate so far
+  tdnode_t *curr = t->root; // start from root
+  while (curr != NULL)      // traverse until a missing child
+  {
+    const int qualifies = curr->key >= key; // curr is a candidate
+    if (qualifies)                          // remember it
+      best = curr;                          // and look for an earlier one
+    curr = curr->link[!qualifies];          // too small: go right
+  }
+  return best; // first qualifying node or NULL
+}
+
+/* Purpose: Remove one copy of key in one pass from the root; returns 0 if the key is absent. */
+int rbtree_td_erase(rbtree_td *t, const key_t key)
+{
+  if (t == NULL || t->root == NULL) // nothing to erase
+    return 0;                       // nothing done
+
+  tdnode_t head = {{NULL, t->root}, 0, RBTREE_BLACK}; // false root above the real one
+  tdnode_t *q = &head;                                // current node
+  tdnode_t *p = NULL, *g = NULL;                      // parent and grandparent
+  tdnode_t *found = NULL;                             // last node seen holding key
+  int dir = 1;                                        // head's only child is on the right
+  while (q->link[dir] != NULL)                        // walk to a leaf, keeping the current node red
+  {
+    const int last = dir; // side taken into q
+    g = p;                // slide down
+    p = q;                // slide down
+    q = q->link[dir];     // next node
+    dir = q->key < key;   // equal keys go left: the key's lower bound is on this path
+    if (q->key == key)    // candidate
+      found = q;          // its key will be replaced by the leaf's
+
+    if (is_red(q) || is_red(q->link[dir])) // q or the next node is already red
+      continue;                            // nothing to push down
+    if (is_red(q->link[!dir]))             // red on the other side: rotate it above q
+    {
+      p = p->link[last] = rotate(q, dir); // q turns red under its old child
+      continue;                           // q is red now
+    }
+    tdnode_t *s = p->link[!last];                   // q's sibling
+    if (s == NULL)                                  // only at the top: nothing to borrow from
+      continue;                                     // q is the root's child and may stay black
+    if (!is_red(s->link[0]) && !is_red(s->link[1])) // sibling has no red child: merge
+    {
+      p->color = RBTREE_BLACK; // p was red (the previous step made it so)
+      s->color = RBTREE_RED;   // sibling joins the merge
+      q->color = RBTREE_RED;   // q is red now
+    }
+    else // sibling has a red child: borrow through a rotation at p
+    {
+      const int dir2 = g->link[1] == p;        // side p hangs from
+      if (is_red(s->link[last]))               // inner nephew is red
+        g->link[dir2] = rotate_twice(p, last); // zig-zag
+      else
+        g->link[dir2] = rotate(p, last); // outer nephew is red: straight line
+      tdnode_t *r = g->link[dir2];       // new top of this subtree
+      q->color = r->color = RBTREE_RED;  // q is red now, and r takes p's red
+      r->link[0]->color = RBTREE_BLACK;  // r's children are black
+      r->link[1]->color = RBTREE_BLACK;  // so black heights match
+    }
+  }
+
+  if (found != NULL) // q is the leaf at the end of found's path, red or with a red child
+  {
+    found->key = q->key;                                    // q's key takes the erased key's place
+    p->link[p->link[1] == q] = q->link[q->link[0] == NULL]; // splice q out
+    slab_free(&t->slab, &node_kind, q);                     // recycle removed node
+    t->count--;                                             // one key less
+  }
+  t->root = head.link[1];          // the top may have rotated or been removed
+  if (t->root != NULL)             // tree is not empty
+    t->root->color = RBTREE_BLACK; // ensure root is black
+  return found != NULL;            // 1 if a copy was removed
+}
+
+/* Purpose: Copy up to n keys in order into arr, with a stack standing in for parent pointers; returns how many were copied. */
+int rbtree_td_to_array(const rbtree_td *t, key_t *arr, const size_t n)
+{
+  const tdnode_t *stack[TD_MAX_DEPTH];         // nodes whose key is still to come, next on top
+  int depth = 0;                               // entries in stack
+  size_t i = 0;                                // keys written
+  const tdnode_t *curr = t->root;              // start from root
+  while (i < n && (curr != NULL || depth > 0)) // room left and keys left
+  {
+    while (curr != NULL) // left spine first
+    {
+      stack[depth++] = curr; // visit after its left subtree
+      curr = curr->link[0];  // move left
+    }
+    curr = stack[--depth]; // smallest pending key
+    arr[i++] = curr->key;  // in-order copy
+    curr = curr->link[1];  // then its right subtree
+  }
+  return (int)i; // keys written
+}
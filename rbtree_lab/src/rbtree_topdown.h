@@ -0,0 +1,39 @@
+#ifndef _RBTREE_TOPDOWN_H_
+#define _RBTREE_TOPDOWN_H_
+
+#include "rbtree.h"
+
+// Top-down red-black tree: insert and erase fix colors and rotate on the way down, in the same
+// single pass that finds the spot, so nothing climbs back up and nodes need no parent pointer.
+// A node is two child links, the key and the color: 24 bytes with int keys instead of 32.
+//
+// Erase takes a key and removes one copy of it. Like any single-pass delete it unlinks the leaf
+// next to that key and moves the leaf's key into the node the key was found in, so a node
+// pointer returned by insert or find is only valid until the next erase.
+typedef struct tdnode_t
+{
+  struct tdnode_t *link[2]; // [0] left, [1] right; NULL: no child
+  key_t key;
+  color_t color;
+} tdnode_t;
+
+typedef struct
+{
+  tdnode_t *root;   // NULL when empty
+  size_t count;     // number of keys stored
+  rbtree_slab slab; // nodes, carved like rbtree's; erased ones are linked through link[1]
+} rbtree_td;
+
+rbtree_td *new_rbtree_td(void);
+void delete_rbtree_td(rbtree_td *);
+
+tdnode_t *rbtree_td_insert(rbtree_td *, const key_t);
+tdnode_t *rbtree_td_find(const rbtree_td *, const key_t);
+tdnode_t *rbtree_td_min(const rbtree_td *);
+tdnode_t *rbtree_td_max(const rbtree_td *);
+tdnode_t *rbtree_td_lower_bound(const rbtree_td *, const key_t);
+int rbtree_td_erase(rbtree_td *, const key_t);
+
+int rbtree_td_to_array(const rbtree_td *, key_t *, const size_t);
+
+#endif // _RBTREE_TOPDOWN_H_
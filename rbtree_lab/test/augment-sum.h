@@ -0,0 +1,8 @@
+#ifndef _AUGMENT_SUM_H_
+#define _AUGMENT_SUM_H_
+
+// Sample augmentation: every node keeps the sum of the keys in its subtree.
+#define RBTREE_AUGMENT_FIELDS long long sum;
+#define RBTREE_AUGMENT_UPDATE(t, n) ((n)->sum = (n)->left->sum + (n)->right->sum + (n)->key)
+
+#endif // _AUGMENT_SUM_H_
@@ -0,0 +1,361 @@
+#include <assert.h>
+#include "rbtree_btree.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LEAF_CAP ((int)RBTREE_BT_LEAF_KEYS)
+#define INNER_CAP ((int)RBTREE_BT_INNER_KEYS)
+#define LEAF_MIN (LEAF_CAP / 2)          // a split leaf keeps the lower half
+#define INNER_MIN ((INNER_CAP - 1) / 2) // a split inner node also gives its middle separator away
+
+static btinner_t *inner(const void *n)
+{
+  return (btinner_t *)n;
+}
+
+static btleaf_t *leaf(const void *n)
+{
+  return (btleaf_t *)n;
+}
+
+// separators bound the subtree from above (lo <= key <= hi, duplicates may sit on both sides of an
+// equal separator); non-root nodes keep their minimum fill; leaves are collected left to right
+static void check_node(const void *n, const int level, const int is_root, const key_t lo, const key_t hi,
+                       const btleaf_t ***leaves)
+{
+  if (level == 0)
+  {
+    const btleaf_t *l = leaf(n);
+    assert(is_root ? l->n > 0 : l->n >= LEAF_MIN);
+    assert(l->n <= LEAF_CAP);
+    for (int i = 0; i < l->n; i++)
+    {
+      assert(lo <= l->keys[i] && l->keys[i] <= hi);
+      assert(i == 0 || l->keys[i - 1] <= l->keys[i]);
+    }
+    *(*leaves)++ = l;
+    return;
+  }
+  const btinner_t *in = inner(n);
+  assert(is_root ? in->n > 0 : in->n >= INNER_MIN);
+  assert(in->n <= INNER_CAP);
+  for (int i = 0; i <= in->n; i++)
+  {
+    const key_t child_lo = i == 0 ? lo : in->keys[i - 1];
+    const key_t child_hi = i == in->n ? hi : in->keys[i];
+    assert(child_lo <= child_hi);
+    check_node(in->child[i], level - 1, 0, child_lo, child_hi, leaves);
+  }
+}
+
+// the leaf chain from head must visit exactly the leaves of the tree, in order, and hold count keys
+static void check_btree(const rbtree_bt *t)
+{
+  if (t->root == NULL)
+  {
+    assert(t->count == 0 && t->head == NULL && t->height == 0);
+    return;
+  }
+  const btleaf_t **order = malloc((t->count + 1) * sizeof(btleaf_t *));
+  const btleaf_t **end = order;
+  check_node(t->root, t->height, 1, INT_MIN, INT_MAX, &end);
+  size_t keys = 0;
+  const btleaf_t *l = t->head;
+  for (const btleaf_t **p = order; p < end; p++, l = l->next)
+  {
+    assert(l == *p);
+    assert(l->next == NULL || l->keys[l->n - 1] <= l->next->keys[0]);
+    keys += l->n;
+  }
+  assert(l == NULL);
+  assert(keys == t->count);
+  free(order);
+}
+
+// nodes should fill whole cache lines and hold 16-64 keys
+void test_layout(void)
+{
+  assert(sizeof(btleaf_t) == RBTREE_BT_NODE_BYTES);
+  assert(sizeof(btinner_t) <= RBTREE_BT_NODE_BYTES);
+  assert(LEAF_CAP >= 16 && LEAF_CAP <= 64);
+  assert(INNER_CAP >= 16 && INNER_CAP <= 64);
+}
+
+// a full root leaf splits in halves under a new root; the separator is the right half's first key
+void test_leaf_split(void)
+{
+  rbtree_bt *t = new_rbtree_bt();
+  for (key_t k = 0; k < LEAF_CAP; k++)
+  {
+    assert(rbtree_bt_insert(t, k));
+  }
+  assert(t->height == 0 && t->root == t->head);
+  assert(t->head->n == LEAF_CAP && t->head->next == NULL);
+
+  assert(rbtree_bt_insert(t, LEAF_CAP));
+  const btinner_t *root = inner(t->root);
+  const btleaf_t *l = t->head, *r = l->next;
+  assert(t->height == 1 && root->n == 1);
+  assert(root->child[0] == l && root->child[1] == r && r->next == NULL);
+  assert(l->n == LEAF_MIN && r->n == LEAF_CAP - LEAF_MIN + 1);
+  assert(root->keys[0] == r->keys[0] && l->keys[l->n - 1] < root->keys[0]);
+  assert(*rbtree_bt_max(t) == LEAF_CAP);
+  check_btree(t);
+  delete_rbtree_bt(t);
+}
+
+// a full inner root splits around its middle separator, which moves up instead of being copied
+void test_inner_split(void)
+{
+  rbtree_bt *t = new_rbtree_bt();
+  key_t k = 0;
+  while (t->height < 2)
+  {
+    const int root_full = t->height == 1 && inner(t->root)->n == INNER_CAP;
+    assert(rbtree_bt_insert(t, k++));
+    assert(t->height < 2 || root_full);
+  }
+  const btinner_t *root = inner(t->root);
+  const btinner_t *l = inner(root->child[0]), *r = inner(root->child[1]);
+  assert(root->n == 1);
+  assert(l->n == INNER_CAP / 2 && r->n == INNER_CAP - INNER_CAP / 2 - 1);
+  assert(root->keys[0] == leaf(r->child[0])->keys[0]);
+  assert(root->keys[0] > l->keys[l->n - 1] && root->keys[0] < r->keys[0]);
+  check_btree(t);
+  delete_rbtree_bt(t);
+}
+
+// an underfull leaf takes a key from its left sibling, else from its right one, else merges and the
+// root collapses into the surviving leaf
+void test_leaf_borrow_merge(void)
+{
+  rbtree_bt *t = new_rbtree_bt();
+  for (key_t k = 0; k <= LEAF_CAP; k++)
+  {
+    assert(rbtree_bt_insert(t, k));
+  }
+  assert(rbtree_bt_insert(t, 10)); // left leaf can now spare one
+  btinner_t *root = inner(t->root);
+  btleaf_t *l = t->head, *r = l->next;
+  assert(l->n == LEAF_MIN + 1 && r->n == LEAF_MIN + 1);
+
+  // right leaf drops below half: its left sibling hands over its largest key
+  assert(rbtree_bt_erase(t, LEAF_CAP));
+  assert(rbtree_bt_erase(t, LEAF_CAP - 1));
+  assert(l->n == LEAF_MIN && r->n == LEAF_MIN);
+  assert(r->keys[0] == LEAF_MIN - 1 && root->keys[0] == LEAF_MIN - 1);
+  check_btree(t);
+
+  // left leaf drops below half: the right one has nothing to spare, so they merge into the root
+  assert(rbtree_bt_erase(t, 0));
+  assert(t->height == 0 && t->root == l && t->head == l && l->next == NULL);
+  assert(l->n == 2 * LEAF_MIN - 1);
+  check_btree(t);
+  delete_rbtree_bt(t);
+
+  // the same from the left end, with the right leaf able to spare its smallest key
+  t = new_rbtree_bt();
+  for (key_t k = 0; k <= LEAF_CAP; k++)
+  {
+    assert(rbtree_bt_insert(t, k));
+  }
+  root = inner(t->root);
+  l = t->head, r = l->next;
+  assert(rbtree_bt_erase(t, 0));
+  assert(l->n == LEAF_MIN && r->n == LEAF_MIN);
+  assert(l->keys[LEAF_MIN - 1] == LEAF_MIN && root->keys[0] == LEAF_MIN + 1 && r->keys[0] == LEAF_MIN + 1);
+  check_btree(t);
+  delete_rbtree_bt(t);
+}
+
+// ascending keys until the root splits into two inner nodes: the left one has a separator to spare
+static rbtree_bt *two_inner_levels(void)
+{
+  rbtree_bt *t = new_rbtree_bt();
+  for (key_t k = 0; t->height < 2; k++)
+  {
+    assert(rbtree_bt_insert(t, k));
+  }
+  return t;
+}
+
+// inner nodes borrow through the parent's separator in both directions, merge, and the root collapses
+// level by level down to an empty tree; every merge must also unchain the freed leaf
+void test_inner_borrow_merge(void)
+{
+  rbtree_bt *t = two_inner_levels();
+  btinner_t *root = inner(t->root);
+  btinner_t *l = inner(root->child[0]), *r = inner(root->child[1]);
+  assert(l->n == INNER_MIN + 1 && r->n == INNER_MIN);
+
+  // erasing from the top merges leaves under r until it needs a child from l
+  key_t sep = 0, last = 0;
+  while (l->n == INNER_MIN + 1)
+  {
+    sep = root->keys[0];
+    last = l->keys[l->n - 1];
+    assert(rbtree_bt_erase(t, *rbtree_bt_max(t)));
+    check_btree(t);
+  }
+  assert(l->n == INNER_MIN && r->n == INNER_MIN);
+  assert(r->keys[0] == sep && root->keys[0] == last);
+
+  // one more merge under r: neither side can spare, so r merges into l and l becomes the root
+  while (t->height == 2)
+  {
+    assert(rbtree_bt_erase(t, *rbtree_bt_max(t)));
+    check_btree(t);
+  }
+  assert(t->root == l && l->n == 2 * INNER_MIN);
+
+  // and down through a leaf root to nothing
+  while (t->count > 0)
+  {
+    assert(rbtree_bt_erase(t, *rbtree_bt_max(t)));
+    check_btree(t);
+  }
+  assert(t->root == NULL && t->head == NULL);
+  assert(rbtree_bt_min(t) == NULL && rbtree_bt_max(t) == NULL);
+  assert(rbtree_bt_lower_bound(t, 0) == NULL && !rbtree_bt_erase(t, 0));
+  key_t k;
+  assert(rbtree_bt_to_array(t, &k, 1) == 0);
+  delete_rbtree_bt(t);
+
+  // erasing from the bottom, r gains children first so that l, once underfull, borrows from r
+  t = two_inner_levels();
+  root = inner(t->root);
+  l = inner(root->child[0]), r = inner(root->child[1]);
+  for (key_t next = *rbtree_bt_max(t) + 1; r->n < INNER_MIN + 3; next++)
+  {
+    assert(rbtree_bt_insert(t, next));
+  }
+  key_t first = 0;
+  while (r->n == INNER_MIN + 3)
+  {
+    sep = root->keys[0];
+    first = r->keys[0];
+    assert(rbtree_bt_erase(t, *rbtree_bt_min(t)));
+    check_btree(t);
+  }
+  assert(l->n == INNER_MIN && r->n == INNER_MIN + 2);
+  assert(l->keys[INNER_MIN - 1] == sep && root->keys[0] == first);
+  delete_rbtree_bt(t);
+}
+
+// fill a tree with `fives` copies of 5, then `sevens` copies of 7
+static rbtree_bt *fives_then_sevens(const int fives, const int sevens)
+{
+  rbtree_bt *t = new_rbtree_bt();
+  for (int i = 0; i < fives + sevens; i++)
+  {
+    assert(rbtree_bt_insert(t, i < fives ? 5 : 7));
+  }
+  return t;
+}
+
+// a split inside a run of equal keys leaves copies on both sides of an equal separator
+void test_duplicates_straddle(void)
+{
+  // copies on both sides: find and erase start from the leftmost one
+  rbtree_bt *t = fives_then_sevens(20, LEAF_CAP - 20 + 1);
+  btinner_t *root = inner(t->root);
+  btleaf_t *l = t->head, *r = l->next;
+  assert(t->height == 1 && root->keys[0] == 7);
+  assert(l->keys[l->n - 1] == 7 && r->keys[0] == 7);
+  assert(rbtree_bt_find(t, 7) == &l->keys[20] && rbtree_bt_lower_bound(t, 6) == &l->keys[20]);
+  for (int i = 0; i < LEAF_CAP - 20 + 1; i++)
+  {
+    assert(rbtree_bt_erase(t, 7));
+    check_btree(t);
+  }
+  assert(!rbtree_bt_erase(t, 7) && rbtree_bt_find(t, 7) == NULL);
+  assert(t->count == 20 && *rbtree_bt_max(t) == 5);
+  delete_rbtree_bt(t);
+
+  // copies only right of the equal separator: erase has to step past the left child
+  t = fives_then_sevens(LEAF_MIN, LEAF_CAP - LEAF_MIN);
+  assert(t->height == 0);
+  for (int i = 0; i < LEAF_MIN; i++)
+  {
+    assert(rbtree_bt_insert(t, 9)); // the first one splits the full leaf between the 5s and the 7s
+  }
+  root = inner(t->root);
+  l = t->head, r = l->next;
+  assert(root->n == 1 && root->keys[0] == 7);
+  assert(l->n == LEAF_MIN && l->keys[LEAF_MIN - 1] == 5);
+  assert(r->n == LEAF_CAP && r->keys[0] == 7);
+  int erased = 0;
+  while (rbtree_bt_erase(t, 7))
+  {
+    assert(l->n == LEAF_MIN);
+    erased++;
+  }
+  assert(erased == LEAF_CAP - LEAF_MIN && r->n == LEAF_MIN);
+  check_btree(t);
+
+  // the separator is stale now: no 7 is left, and lower_bound runs off the left leaf into the next one
+  assert(root->keys[0] == 7 && r->keys[0] == 9);
+  assert(rbtree_bt_find(t, 7) == NULL);
+  assert(rbtree_bt_lower_bound(t, 6) == &r->keys[0] && rbtree_bt_lower_bound(t, 7) == &r->keys[0]);
+  assert(rbtree_bt_insert(t, 7));
+  assert(rbtree_bt_find(t, 7) == &r->keys[0]);
+  assert(rbtree_bt_erase(t, 7) && l->n == LEAF_MIN && r->keys[0] == 9);
+  delete_rbtree_bt(t);
+}
+
+// a long run of one key spans many leaves and equal separators on every level
+void test_duplicates_deep(const int copies)
+{
+  rbtree_bt *t = new_rbtree_bt();
+  for (int i = 0; i < copies; i++)
+  {
+    assert(rbtree_bt_insert(t, 7));
+    if (i % 10 == 0)
+    {
+      assert(rbtree_bt_insert(t, 3));
+      assert(rbtree_bt_insert(t, 9));
+    }
+  }
+  check_btree(t);
+  assert(t->height >= 2);
+  const int others = (copies + 9) / 10;
+  assert(rbtree_bt_lower_bound(t, 4) == rbtree_bt_find(t, 7));
+
+  key_t *arr = calloc(t->count, sizeof(key_t));
+  assert(rbtree_bt_to_array(t, arr, t->count) == (int)t->count);
+  assert(arr[others - 1] == 3 && arr[others] == 7 && arr[others + copies - 1] == 7 && arr[others + copies] == 9);
+
+  for (int i = 0; i < copies; i++)
+  {
+    assert(rbtree_bt_erase(t, 7));
+    assert(rbtree_bt_find(t, 3) != NULL && rbtree_bt_find(t, 9) != NULL);
+    if (i % 64 == 0)
+    {
+      check_btree(t);
+    }
+  }
+  check_btree(t);
+  assert(!rbtree_bt_erase(t, 7));
+  assert(t->count == (size_t)(2 * others));
+  assert(*rbtree_bt_lower_bound(t, 4) == 9);
+  assert(rbtree_bt_to_array(t, arr, t->count) == 2 * others);
+  for (int i = 0; i < 2 * others; i++)
+  {
+    assert(arr[i] == (i < others ? 3 : 9));
+  }
+  free(arr);
+  delete_rbtree_bt(t);
+}
+
+int main(void)
+{
+  test_layout();
+  test_leaf_split();
+  test_inner_split();
+  test_leaf_borrow_merge();
+  test_inner_borrow_merge();
+  test_duplicates_straddle();
+  test_duplicates_deep(3000);
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,216 @@
+#include <assert.h>
+#include "rbtree_keys.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+RBTREE_DEFINE(rbtree_int, int, RBTREE_LESS)
+
+#define N 2000
+
+// Invariant check for any generated tree type: red nodes have black children, every path has
+// the same black count, parent links match and keys are ordered.
+#define CHECK_DEFINE(name, less)                                                 \
+  static int name##_check_subtree(const name *t, const name##_node *n)           \
+  {                                                                              \
+    if (n == t->nil)                                                             \
+      return 1;                                                                  \
+    if (n->color == RBTREE_RED)                                                  \
+      assert(n->left->color == RBTREE_BLACK && n->right->color == RBTREE_BLACK); \
+    if (n->left != t->nil)                                                       \
+      assert(n->left->parent == n && !less(n->key, n->left->key));              \
+    if (n->right != t->nil)                                                      \
+      assert(n->right->parent == n && !less(n->right->key, n->key));             \
+    const int black = name##_check_subtree(t, n->left);                          \
+    assert(black == name##_check_subtree(t, n->right));                          \
+    return black + (n->color == RBTREE_BLACK);                                   \
+  }                                                                              \
+  static void name##_check(const name *t)                                        \
+  {                                                                              \
+    assert(t->root == t->nil || t->root->color == RBTREE_BLACK);                 \
+    assert(t->root == t->nil || t->root->parent == t->nil);                      \
+    name##_check_subtree(t, t->root);                                            \
+  }
+
+CHECK_DEFINE(rbtree_int, RBTREE_LESS)
+CHECK_DEFINE(rbtree_i64, RBTREE_LESS)
+CHECK_DEFINE(rbtree_f64, RBTREE_LESS)
+CHECK_DEFINE(rbtree_str, RBTREE_STR_LESS)
+
+static int comp_int(const void *p1, const void *p2)
+{
+  const int a = *(const int *)p1, b = *(const int *)p2;
+  return (a > b) - (a < b);
+}
+
+static int comp_i64(const void *p1, const void *p2)
+{
+  const int64_t a = *(const int64_t *)p1, b = *(const int64_t *)p2;
+  return (a > b) - (a < b);
+}
+
+static int comp_f64(const void *p1, const void *p2)
+{
+  const double a = *(const double *)p1, b = *(const double *)p2;
+  return (a > b) - (a < b);
+}
+
+static int comp_str(const void *p1, const void *p2)
+{
+  return strcmp(*(const char *const *)p1, *(const char *const *)p2);
+}
+
+// empty trees answer every query with NULL
+void test_empty(void)
+{
+  rbtree_i64 *t = new_rbtree_i64();
+  assert(t->count == 0);
+  assert(rbtree_i64_find(t, 1) == NULL);
+  assert(rbtree_i64_min(t) == NULL && rbtree_i64_max(t) == NULL);
+  assert(rbtree_i64_lower_bound(t, 0) == NULL);
+  assert(!rbtree_i64_erase(t, NULL));
+  int64_t k;
+  assert(rbtree_i64_to_array(t, &k, 1) == 0);
+  delete_rbtree_i64(t);
+}
+
+// keys beyond the range of int keep their full width and order
+void test_i64(void)
+{
+  rbtree_i64 *t = new_rbtree_i64();
+  int64_t keys[N];
+  srand(11);
+  for (int i = 0; i < N; i++)
+  {
+    keys[i] = ((int64_t)rand() << 32 | (int64_t)rand()) - (i % 2 ? INT64_C(1) << 61 : 0);
+    assert(rbtree_i64_insert(t, keys[i])->key == keys[i]);
+  }
+  rbtree_i64_check(t);
+  for (int i = 0; i < N; i++)
+  {
+    assert(rbtree_i64_find(t, keys[i])->key == keys[i]);
+  }
+  for (int i = 0; i < N; i += 2)
+  {
+    assert(rbtree_i64_erase(t, rbtree_i64_find(t, keys[i])));
+    keys[i / 2] = keys[i + 1]; // survivors move to the front
+    rbtree_i64_check(t);
+  }
+  assert(t->count == N / 2);
+  qsort(keys, N / 2, sizeof(int64_t), comp_i64);
+  int64_t res[N / 2];
+  assert(rbtree_i64_to_array(t, res, N) == N / 2);
+  assert(memcmp(res, keys, sizeof(res)) == 0);
+  assert(rbtree_i64_min(t)->key == keys[0] && rbtree_i64_max(t)->key == keys[N / 2 - 1]);
+  delete_rbtree_i64(t);
+}
+
+// fractional keys, duplicates included, come back in order from both ends
+void test_f64(void)
+{
+  rbtree_f64 *t = new_rbtree_f64();
+  double keys[N];
+  srand(12);
+  for (int i = 0; i < N; i++)
+  {
+    keys[i] = (rand() % 500) / 8.0 - 20.0;
+    rbtree_f64_insert(t, keys[i]);
+  }
+  rbtree_f64_check(t);
+  qsort(keys, N, sizeof(double), comp_f64);
+  int i = 0;
+  for (rbtree_f64_node *p = rbtree_f64_min(t); p != NULL; p = rbtree_f64_next(t, p))
+  {
+    assert(p->key == keys[i++]);
+  }
+  assert(i == N);
+  for (rbtree_f64_node *p = rbtree_f64_max(t); p != NULL; p = rbtree_f64_prev(t, p))
+  {
+    assert(p->key == keys[--i]);
+  }
+  assert(rbtree_f64_lower_bound(t, -0.01)->key == 0.0);
+  assert(rbtree_f64_lower_bound(t, 1000.0) == NULL);
+  while (t->count > 0)
+  {
+    assert(rbtree_f64_erase(t, t->root));
+  }
+  rbtree_f64_check(t);
+  delete_rbtree_f64(t);
+}
+
+// string keys compare by content, not by pointer
+void test_str(void)
+{
+  rbtree_str *t = new_rbtree_str();
+  char buf[N][8];
+  const char *keys[N];
+  srand(13);
+  for (int i = 0; i < N; i++)
+  {
+    snprintf(buf[i], sizeof(buf[i]), "k%d", rand() % 1000);
+    keys[i] = buf[i];
+    rbtree_str_insert(t, keys[i]);
+  }
+  rbtree_str_check(t);
+  char probe[8];
+  for (int i = 0; i < N; i++)
+  {
+    strcpy(probe, keys[i]); // different address, same contents
+    assert(strcmp(rbtree_str_find(t, probe)->key, keys[i]) == 0);
+  }
+  assert(rbtree_str_find(t, "k1000") == NULL); // k1000 sorts between k100 and k101 but is absent
+  qsort(keys, N, sizeof(const char *), comp_str);
+  const char *res[N];
+  assert(rbtree_str_to_array(t, res, N) == N);
+  for (int i = 0; i < N; i++)
+  {
+    assert(strcmp(res[i], keys[i]) == 0);
+  }
+  delete_rbtree_str(t);
+}
+
+// random inserts and erases against a sorted reference, erasing through the slab free list
+void test_random(void)
+{
+  rbtree_int *t = new_rbtree_int();
+  int keys[N];
+  size_t n = 0;
+  srand(14);
+  for (int step = 0; step < 20 * N; step++)
+  {
+    if (n > 0 && (n == N || rand() % 2))
+    {
+      const size_t at = (size_t)rand() % n;
+      rbtree_int_node *p = rbtree_int_find(t, keys[at]);
+      assert(p != NULL && p->key == keys[at]);
+      assert(rbtree_int_erase(t, p));
+      keys[at] = keys[--n];
+    }
+    else
+    {
+      keys[n] = rand() % (N / 2);
+      assert(rbtree_int_insert(t, keys[n++]) != NULL);
+    }
+    if (step % 1000 == 0)
+    {
+      rbtree_int_check(t);
+    }
+  }
+  assert(t->count == n);
+  int sorted[N], res[N];
+  memcpy(sorted, keys, n * sizeof(int));
+  qsort(sorted, n, sizeof(int), comp_int);
+  assert(rbtree_int_to_array(t, res, N) == n);
+  assert(memcmp(res, sorted, n * sizeof(int)) == 0);
+  delete_rbtree_int(t);
+}
+
+int main(void)
+{
+  test_empty();
+  test_i64();
+  test_f64();
+  test_str();
+  test_random();
+  printf("Passed all tests!\n");
+}
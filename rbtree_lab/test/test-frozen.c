@@ -0,0 +1,112 @@
+#include <assert.h>
+#include "rbtree_frozen.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// keys[1..n] should be an in-order layout of the tree: each slot between its subtrees, nodes matching
+static void check_layout(const rbtree *t, const rbtree_frozen *f)
+{
+  node_t *p = rbtree_min(t);
+  size_t k = 1;
+  while (k <= f->n && 2 * k <= f->n)
+  {
+    k *= 2;
+  }
+  // walk slots in order: leftmost slot first, then in-order successor of the implicit tree
+  for (size_t visited = 0; visited < f->n; visited++)
+  {
+    assert(p != NULL);
+    assert(f->nodes[k] == p && f->keys[k] == p->key);
+    p = rbtree_next(t, p);
+    if (2 * k + 1 <= f->n)
+    {
+      k = 2 * k + 1;
+      while (2 * k <= f->n)
+      {
+        k *= 2;
+      }
+    }
+    else
+    {
+      while (k & 1)
+      {
+        k >>= 1;
+      }
+      k >>= 1;
+    }
+  }
+  assert(p == NULL);
+  assert(((uintptr_t)f->keys & 63) == 0);
+}
+
+// an empty tree freezes to an empty snapshot
+void test_empty(void)
+{
+  rbtree *t = new_rbtree();
+  rbtree_frozen *f = rbtree_freeze(t);
+  assert(f != NULL && f->n == 0);
+  assert(rbtree_frozen_find(f, 1) == NULL);
+  assert(rbtree_frozen_lower_bound(f, 0) == NULL);
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+}
+
+// every size up to a few complete levels, so both the full and the partial last level are covered
+void test_sizes(const size_t max)
+{
+  for (size_t n = 1; n <= max; n++)
+  {
+    rbtree *t = new_rbtree();
+    for (size_t i = 0; i < n; i++)
+    {
+      rbtree_insert(t, (key_t)(2 * i));
+    }
+    rbtree_frozen *f = rbtree_freeze(t);
+    check_layout(t, f);
+    for (key_t key = -1; key <= (key_t)(2 * n); key++)
+    {
+      assert(rbtree_frozen_find(f, key) == rbtree_find(t, key));
+      assert(rbtree_frozen_lower_bound(f, key) == rbtree_lower_bound(t, key));
+    }
+    delete_rbtree_frozen(f);
+    delete_rbtree(t);
+  }
+}
+
+// random keys with duplicates: queries should return the same node as the tree's lower_bound
+void test_random(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_insert(t, rand() % (key_t)(n / 4 + 1) - (key_t)(n / 8));
+  }
+  rbtree_frozen *f = rbtree_freeze(t);
+  check_layout(t, f);
+  for (int q = 0; q < 20000; q++)
+  {
+    const key_t key = rand() % (key_t)(n / 4 + 3) - (key_t)(n / 8) - 1;
+    const node_t *p = rbtree_frozen_lower_bound(f, key);
+    assert(p == rbtree_lower_bound(t, key));
+    const node_t *h = rbtree_frozen_find(f, key);
+    assert(h == NULL ? rbtree_find(t, key) == NULL : h->key == key);
+  }
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+}
+
+int main(void)
+{
+#ifdef __AVX2__
+  if (!__builtin_cpu_supports("avx2"))
+  {
+    printf("Passed all tests! (AVX2 build skipped: this CPU has no AVX2)\n");
+    return 0;
+  }
+#endif
+  test_empty();
+  test_sizes(300);
+  test_random(1);
+  test_random(50000);
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,174 @@
+#include <assert.h>
+#include "rbtree_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int comp(const void *p1, const void *p2)
+{
+  const key_t *e1 = (const key_t *)p1;
+  const key_t *e2 = (const key_t *)p2;
+  return (*e1 > *e2) - (*e1 < *e2);
+}
+
+// red nodes have black children, every path has the same black count and parent links match
+static int check_subtree(const rbtree_idx *t, const rbidx_t h, const rbidx_t parent)
+{
+  if (h == RBIDX_NIL)
+  {
+    return 1;
+  }
+  const inode_t *n = &t->nodes[h];
+  assert(n->parent_color >> 1 == parent);
+  if ((n->parent_color & 1) == RBTREE_RED)
+  {
+    assert((t->nodes[n->left].parent_color & 1) == RBTREE_BLACK);
+    assert((t->nodes[n->right].parent_color & 1) == RBTREE_BLACK);
+  }
+  if (n->left != RBIDX_NIL)
+  {
+    assert(t->nodes[n->left].key <= n->key);
+  }
+  if (n->right != RBIDX_NIL)
+  {
+    assert(t->nodes[n->right].key >= n->key);
+  }
+  const int black = check_subtree(t, n->left, h);
+  assert(black == check_subtree(t, n->right, h));
+  return black + ((n->parent_color & 1) == RBTREE_BLACK);
+}
+
+static void check_tree(const rbtree_idx *t)
+{
+  assert(t->root == RBIDX_NIL || (t->nodes[t->root].parent_color & 1) == RBTREE_BLACK);
+  check_subtree(t, t->root, RBIDX_NIL);
+}
+
+// nodes should be a quarter of a cache line
+void test_layout(void)
+{
+  assert(sizeof(inode_t) == 16);
+}
+
+// empty tree should answer every query with the sentinel handle
+void test_empty(void)
+{
+  rbtree_idx *t = new_rbtree_idx();
+  assert(t->root == RBIDX_NIL && t->count == 0);
+  assert(rbtree_idx_find(t, 1) == RBIDX_NIL);
+  assert(rbtree_idx_min(t) == RBIDX_NIL);
+  assert(rbtree_idx_max(t) == RBIDX_NIL);
+  assert(rbtree_idx_lower_bound(t, 0) == RBIDX_NIL);
+  assert(!rbtree_idx_erase(t, RBIDX_NIL));
+  key_t k;
+  assert(rbtree_idx_to_array(t, &k, 1) == 0);
+  delete_rbtree_idx(t);
+}
+
+// handles should survive the array growing under them, and erased slots should be reused
+void test_handles(void)
+{
+  rbtree_idx *t = new_rbtree_idx_with_capacity(4);
+  rbidx_t h[1000];
+  for (key_t k = 0; k < 1000; k++)
+  {
+    h[k] = rbtree_idx_insert(t, k * 3);
+    assert(h[k] != RBIDX_NIL);
+  }
+  assert(t->cap >= 1001);
+  for (key_t k = 0; k < 1000; k++)
+  {
+    assert(rbtree_idx_key(t, h[k]) == k * 3);
+    assert(rbtree_idx_find(t, k * 3) == h[k]);
+  }
+  const uint32_t used = t->used;
+  assert(rbtree_idx_erase(t, h[500]));
+  assert(rbtree_idx_insert(t, 1) == h[500]);
+  assert(t->used == used);
+  check_tree(t);
+  delete_rbtree_idx(t);
+}
+
+// random inserts and erases with duplicates should match a sorted reference
+void test_random(const size_t n)
+{
+  rbtree_idx *t = new_rbtree_idx();
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  rbidx_t *handles = calloc(n, sizeof(rbidx_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % (key_t)(n / 2 + 1);
+    handles[i] = rbtree_idx_insert(t, arr[i]);
+  }
+  check_tree(t);
+
+  // erase every other inserted node through its handle
+  size_t kept = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (i % 2 == 0)
+    {
+      assert(rbtree_idx_erase(t, handles[i]));
+    }
+    else
+    {
+      arr[kept++] = arr[i];
+    }
+  }
+  check_tree(t);
+  assert(t->count == kept);
+  qsort(arr, kept, sizeof(key_t), comp);
+  assert(rbtree_idx_to_array(t, res, n + 1) == (int)kept);
+  for (size_t i = 0; i < kept; i++)
+  {
+    assert(res[i] == arr[i]);
+  }
+
+  // walking both ways from the ends visits the same keys
+  size_t i = 0;
+  for (rbidx_t h = rbtree_idx_min(t); h != RBIDX_NIL; h = rbtree_idx_next(t, h))
+  {
+    assert(rbtree_idx_key(t, h) == arr[i++]);
+  }
+  assert(i == kept);
+  for (rbidx_t h = rbtree_idx_max(t); h != RBIDX_NIL; h = rbtree_idx_prev(t, h))
+  {
+    assert(rbtree_idx_key(t, h) == arr[--i]);
+  }
+  assert(i == 0);
+
+  for (int q = 0; q < 100; q++)
+  {
+    const key_t key = rand() % (key_t)(n / 2 + 1) - 1;
+    size_t first = 0;
+    while (first < kept && arr[first] < key)
+    {
+      first++;
+    }
+    const rbidx_t h = rbtree_idx_lower_bound(t, key);
+    assert(first == kept ? h == RBIDX_NIL : rbtree_idx_key(t, h) == arr[first]);
+    assert((rbtree_idx_find(t, key) != RBIDX_NIL) == (first < kept && arr[first] == key));
+  }
+
+  while (t->count > 0)
+  {
+    assert(rbtree_idx_erase(t, t->root));
+  }
+  check_tree(t);
+  assert(t->root == RBIDX_NIL);
+
+  free(handles);
+  free(res);
+  free(arr);
+  delete_rbtree_idx(t);
+}
+
+int main(void)
+{
+  test_layout();
+  test_empty();
+  test_handles();
+  test_random(1);
+  test_random(10000);
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,265 @@
+#include <assert.h>
+#include "rbtree_persist.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KEYS 2000
+#define VERSIONS 8
+
+// red nodes have black children and every path has the same number of black nodes
+static int black_height(const pnode_t *n)
+{
+  if (n == NULL)
+  {
+    return 1;
+  }
+  if (n->color == RBTREE_RED)
+  {
+    assert(n->left == NULL || n->left->color == RBTREE_BLACK);
+    assert(n->right == NULL || n->right->color == RBTREE_BLACK);
+  }
+  assert(n->refs >= 1);
+  const int left = black_height(n->left);
+  assert(left == black_height(n->right));
+  return left + (n->color == RBTREE_BLACK);
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+  const key_t x = *(const key_t *)a, y = *(const key_t *)b;
+  return (x > y) - (x < y);
+}
+
+// snapshot should hold exactly the n sorted keys in expected
+static void check_snap(const rbtree_snap *s, const key_t *expected, const size_t n)
+{
+  assert(s->count == n);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_snap_to_array(s, res, n + 1) == (int)n);
+  assert(n == 0 || memcmp(res, expected, n * sizeof(key_t)) == 0);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(rbtree_snap_find(s, expected[i]));
+  }
+  free(res);
+}
+
+// empty tree and empty snapshot
+void test_empty(void)
+{
+  rbtree_persist *p = new_rbtree_persist();
+  assert(!rbtree_persist_find(p, 1));
+  assert(!rbtree_persist_erase(p, 1));
+  rbtree_snap *s = rbtree_snapshot(p);
+  key_t k;
+  assert(rbtree_snap_to_array(s, &k, 1) == 0);
+  rbtree_snap_cursor cur;
+  rbtree_snap_first(&cur, s);
+  assert(!rbtree_snap_next(&cur, &k));
+  rbtree_snap_release(s);
+  delete_rbtree_persist(p);
+}
+
+// old versions keep their contents while the current one is rewritten around them
+void test_versions(void)
+{
+  rbtree_persist *p = new_rbtree_persist();
+  key_t *keys = calloc(KEYS, sizeof(key_t));
+  size_t n = 0;
+  rbtree_snap *snaps[VERSIONS];
+  key_t *expected[VERSIONS];
+  size_t sizes[VERSIONS];
+
+  srand(7);
+  for (int v = 0; v < VERSIONS; v++)
+  {
+    for (int step = 0; step < KEYS / 2; step++)
+    {
+      if (n > 0 && rand() % 3 == 0)
+      {
+        const size_t at = (size_t)rand() % n;
+        assert(rbtree_persist_erase(p, keys[at]));
+        keys[at] = keys[--n];
+      }
+      else if (n < KEYS)
+      {
+        keys[n] = rand() % (KEYS / 2); // duplicates on purpose
+        assert(rbtree_persist_insert(p, keys[n++]));
+      }
+    }
+    black_height(p->root);
+    assert(p->count == n);
+
+    snaps[v] = rbtree_snapshot(p);
+    expected[v] = calloc(n + 1, sizeof(key_t));
+    memcpy(expected[v], keys, n * sizeof(key_t));
+    qsort(expected[v], n, sizeof(key_t), compare_keys);
+    sizes[v] = n;
+  }
+
+  for (int v = 0; v < VERSIONS; v++)
+  {
+    check_snap(snaps[v], expected[v], sizes[v]);
+    black_height(snaps[v]->root);
+  }
+
+  // release out of order: shared nodes must survive until their last version goes
+  for (int v = 0; v < VERSIONS; v += 2)
+  {
+    rbtree_snap_release(snaps[v]);
+  }
+  while (n > 0)
+  {
+    assert(rbtree_persist_erase(p, keys[--n]));
+  }
+  assert(p->root == NULL && p->count == 0);
+  for (int v = 1; v < VERSIONS; v += 2)
+  {
+    check_snap(snaps[v], expected[v], sizes[v]);
+    rbtree_snap_release(snaps[v]);
+  }
+  for (int v = 0; v < VERSIONS; v++)
+  {
+    free(expected[v]);
+  }
+  free(keys);
+  delete_rbtree_persist(p);
+}
+
+static size_t collect(const pnode_t *n, const pnode_t **out, size_t i)
+{
+  if (n == NULL)
+  {
+    return i;
+  }
+  i = collect(n->left, out, i);
+  out[i++] = n;
+  return collect(n->right, out, i);
+}
+
+// without snapshots nothing is shared, so updates never copy
+void test_in_place(void)
+{
+  rbtree_persist *p = new_rbtree_persist();
+  for (key_t k = 0; k < KEYS; k++)
+  {
+    assert(rbtree_persist_insert(p, k));
+  }
+  const pnode_t *root = p->root;
+  rbtree_snap *s = rbtree_snapshot(p);
+  assert(s->root == root && root->refs == 2);
+  assert(rbtree_persist_insert(p, KEYS));
+  assert(p->root != root && s->root == root); // root was copied for the new version
+  assert(root->refs == 1);                    // only the snapshot holds it now
+  rbtree_snap_release(s);
+
+  const pnode_t **before = calloc(KEYS + 1, sizeof(pnode_t *));
+  const pnode_t **after = calloc(KEYS + 1, sizeof(pnode_t *));
+  assert(collect(p->root, before, 0) == KEYS + 1);
+  assert(rbtree_persist_erase(p, KEYS / 2));
+  assert(rbtree_persist_erase(p, KEYS));
+  assert(collect(p->root, after, 0) == KEYS - 1);
+  for (size_t i = 0, j = 0; i < KEYS - 1; i++)
+  {
+    while (before[j] != after[i]) // private again: same nodes, changed in place
+    {
+      assert(++j < KEYS + 1);
+    }
+  }
+  free(before);
+  free(after);
+  delete_rbtree_persist(p);
+}
+
+// cursors walk from a lower bound without parent pointers
+void test_cursor(void)
+{
+  rbtree_persist *p = new_rbtree_persist();
+  for (key_t k = 0; k < 100; k += 10)
+  {
+    rbtree_persist_insert(p, k);
+    rbtree_persist_insert(p, k);
+  }
+  rbtree_snap *s = rbtree_snapshot(p);
+  rbtree_persist_erase(p, 50); // later updates do not affect the cursor's version
+
+  rbtree_snap_cursor cur;
+  key_t k;
+  rbtree_snap_seek(&cur, s, 45);
+  for (key_t want = 50; want < 100; want += 10)
+  {
+    assert(rbtree_snap_next(&cur, &k) && k == want);
+    assert(rbtree_snap_next(&cur, &k) && k == want);
+  }
+  assert(!rbtree_snap_next(&cur, &k));
+
+  rbtree_snap_seek(&cur, s, 90);
+  assert(rbtree_snap_next(&cur, &k) && k == 90);
+  rbtree_snap_seek(&cur, s, 91);
+  assert(!rbtree_snap_next(&cur, &k));
+  rbtree_snap_seek(&cur, s, -5);
+  assert(rbtree_snap_next(&cur, &k) && k == 0);
+
+  rbtree_snap_release(s);
+  delete_rbtree_persist(p);
+}
+
+static rbtree_snap *reading;
+
+// a long scan of one version while the writer keeps going
+static void *scanner(void *arg)
+{
+  key_t *buf = calloc(KEYS, sizeof(key_t));
+  for (int round = 0; round < 200; round++)
+  {
+    assert(rbtree_snap_to_array(reading, buf, KEYS) == KEYS / 2);
+    for (int i = 0; i < KEYS / 2; i++)
+    {
+      assert(buf[i] == 2 * i);
+    }
+  }
+  free(buf);
+  rbtree_snap_release(reading); // may free nodes while the writer is still updating
+  return NULL;
+}
+
+void test_reader_thread(void)
+{
+  rbtree_persist *p = new_rbtree_persist();
+  for (key_t k = 0; k < KEYS; k += 2)
+  {
+    rbtree_persist_insert(p, k);
+  }
+  reading = rbtree_snapshot(p);
+
+  pthread_t t;
+  pthread_create(&t, NULL, scanner, NULL);
+  for (int round = 0; round < 20; round++)
+  {
+    for (key_t k = 0; k < KEYS; k += 2)
+    {
+      assert(rbtree_persist_erase(p, k));
+      assert(rbtree_persist_insert(p, k + 1));
+    }
+    for (key_t k = 0; k < KEYS; k += 2)
+    {
+      assert(rbtree_persist_erase(p, k + 1));
+      assert(rbtree_persist_insert(p, k));
+    }
+  }
+  pthread_join(t, NULL);
+  black_height(p->root);
+  delete_rbtree_persist(p);
+}
+
+int main(void)
+{
+  test_empty();
+  test_versions();
+  test_in_place();
+  test_cursor();
+  test_reader_thread();
+  printf("Passed all tests!\n");
+}
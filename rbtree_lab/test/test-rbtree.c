@@ -4,6 +4,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// keys a node stands for: a counted node holds every copy of its key
+#ifdef RBTREE_COUNTED
+#define node_copies(p) ((p)->dup)
+#else
+#define node_copies(p) ((size_t)1)
+#endif
+
 // new_rbtree should return rbtree struct with null root node
 void test_init(void)
 {
@@ -26,15 +33,15 @@ void test_insert_single(const key_t key)
   assert(p != NULL);
   assert(t->root == p);
   assert(p->key == key);
-  // assert(p->color == RBTREE_BLACK);  // color of root node should be black
+  // assert(rbtree_color(p) == RBTREE_BLACK);  // color of root node should be black
 #ifdef SENTINEL
   assert(p->left == t->nil);
   assert(p->right == t->nil);
-  assert(p->parent == t->nil);
+  assert(rbtree_parent(p) == t->nil);
 #else
   assert(p->left == NULL);
   assert(p->right == NULL);
-  assert(p->parent == NULL);
+  assert(rbtree_parent(p) == NULL);
 #endif
   delete_rbtree(t);
 }
@@ -248,6 +255,7 @@ void test_search_constraint(const rbtree *t)
 // 4. Every path from a given node to any of its descendant NIL nodes goes
 // through the same number of black nodes.
 
+#ifndef RBTREE_RANKED
 bool touch_nil = false;
 int max_black_depth = 0;
 
@@ -273,15 +281,51 @@ static bool color_traverse(const node_t *p, const color_t parent_color,
     }
     return true;
   }
-  if (parent_color == RBTREE_RED && p->color == RBTREE_RED)
+  if (parent_color == RBTREE_RED && rbtree_color(p) == RBTREE_RED)
   {
     return false;
   }
-  int next_depth = ((p->color == RBTREE_BLACK) ? 1 : 0) + black_depth;
-  return color_traverse(p->left, p->color, next_depth, nil) &&
-         color_traverse(p->right, p->color, next_depth, nil);
+#ifdef RBTREE_LLRB
+  // left-leaning: red links only go left, so 3-nodes have one shape
+  if (p->right != nil && rbtree_color(p->right) == RBTREE_RED)
+  {
+    return false;
+  }
+#endif
+  int next_depth = ((rbtree_color(p) == RBTREE_BLACK) ? 1 : 0) + black_depth;
+  return color_traverse(p->left, rbtree_color(p), next_depth, nil) &&
+         color_traverse(p->right, rbtree_color(p), next_depth, nil);
+}
+#endif
+
+#ifdef RBTREE_RANKED
+// AVL: a node's rank is its height and its children's heights differ by at most one.
+// WAVL: every rank difference is 1 or 2, leaves have rank 0 and missing children -1.
+// Returns the height of p.
+static int rank_traverse(const node_t *p, const node_t *nil)
+{
+  if (p == nil)
+  {
+    assert(p->rank == -1);
+    return -1;
+  }
+  const int hl = rank_traverse(p->left, nil);
+  const int hr = rank_traverse(p->right, nil);
+#ifdef RBTREE_AVL
+  assert(hl - hr <= 1 && hr - hl <= 1);
+  assert(p->rank == 1 + (hl > hr ? hl : hr));
+#else
+  const int dl = p->rank - p->left->rank;
+  const int dr = p->rank - p->right->rank;
+  assert(dl == 1 || dl == 2);
+  assert(dr == 1 || dr == 2);
+  assert(p->left != nil || p->right != nil || p->rank == 0);
+#endif
+  return 1 + (hl > hr ? hl : hr);
 }
+#endif
 
+// the balancing backend's invariants (red-black colors, or AVL / WAVL ranks)
 void test_color_constraint(const rbtree *t)
 {
   assert(t != NULL);
@@ -291,10 +335,14 @@ void test_color_constraint(const rbtree *t)
   node_t *nil = NULL;
 #endif
   node_t *p = t->root;
-  assert(p == nil || p->color == RBTREE_BLACK);
+#ifdef RBTREE_RANKED
+  rank_traverse(p, nil);
+#else
+  assert(p == nil || rbtree_color(p) == RBTREE_BLACK);
 
   init_color_traverse();
   assert(color_traverse(p, RBTREE_BLACK, 0, nil));
+#endif
 }
 
 // rbtree should keep search tree and color constraints
@@ -413,6 +461,838 @@ void test_find_erase_rand(const size_t n, const unsigned int seed)
   delete_rbtree(t);
 }
 
+// preallocated capacity should be usable and erased nodes should be recycled
+void test_capacity(void)
+{
+  rbtree *t = new_rbtree_with_capacity(64);
+  assert(t != NULL);
+
+  node_t *p = rbtree_insert(t, 1);
+  assert(p != NULL);
+  rbtree_erase(t, p);
+#ifndef RBTREE_CALLOC_NODES
+  node_t *q = rbtree_insert(t, 2);
+  assert(q == p);
+  rbtree_erase(t, q);
+#endif
+
+  for (int i = 0; i < 1000; i++)
+  {
+    assert(rbtree_insert(t, (i * 7919) % 1000) != NULL);
+  }
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  delete_rbtree(t);
+}
+
+// clear should empty the tree and leave it usable
+void test_clear(void)
+{
+  rbtree *t = new_rbtree();
+  assert(t != NULL);
+
+  for (int round = 0; round < 3; round++)
+  {
+    for (int i = 0; i < 5000; i++)
+    {
+      assert(rbtree_insert(t, i) != NULL);
+    }
+    rbtree_clear(t);
+#ifdef SENTINEL
+    assert(t->root == t->nil);
+#else
+    assert(t->root == NULL);
+#endif
+    assert(rbtree_find(t, 0) == NULL);
+  }
+
+  rbtree_insert(t, 42);
+  assert(rbtree_find(t, 42) != NULL);
+  test_color_constraint(t);
+
+  delete_rbtree(t);
+}
+
+// building from a sorted array should give a valid tree holding the same keys
+void test_from_sorted_array(const size_t n)
+{
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = (key_t)(i / 3); // keep duplicates
+  }
+
+  rbtree *t = rbtree_from_sorted_array(arr, n);
+  assert(t != NULL);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  rbtree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(arr[i] == res[i]);
+  }
+
+  // the result should behave like any other tree
+  rbtree_insert(t, -1);
+  if (n > 0)
+  {
+    rbtree_erase(t, rbtree_find(t, arr[n / 2]));
+  }
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+void test_from_sorted_array_suite()
+{
+  for (size_t n = 0; n < 70; n++)
+  {
+    test_from_sorted_array(n);
+  }
+  test_from_sorted_array(100000);
+}
+
+// batch insert should merge keys into any tree, keeping existing nodes valid
+void test_insert_batch(const size_t base, const size_t batch)
+{
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(base + batch + 1, sizeof(key_t));
+  for (size_t i = 0; i < base + batch; i++)
+  {
+    arr[i] = rand() % 1000; // plenty of duplicates
+  }
+  insert_arr(t, arr, base);
+  node_t *kept = base > 0 ? rbtree_find(t, arr[0]) : NULL;
+
+  assert(rbtree_insert_batch(t, arr + base, batch) == batch);
+  assert(t->count == base + batch);
+  test_color_constraint(t);
+  test_search_constraint(t);
+  if (kept != NULL)
+  {
+    assert(kept->key == arr[0]);
+    rbtree_erase(t, kept);
+    insert_arr(t, arr, 1);
+  }
+
+  qsort((void *)arr, base + batch, sizeof(key_t), comp);
+  key_t *res = calloc(base + batch + 1, sizeof(key_t));
+  rbtree_to_array(t, res, base + batch);
+  for (size_t i = 0; i < base + batch; i++)
+  {
+    assert(arr[i] == res[i]);
+  }
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+void test_insert_batch_suite()
+{
+  test_insert_batch(0, 0);
+  test_insert_batch(0, 100);  // rebuild into an empty tree
+  test_insert_batch(1000, 1); // small batch: plain rbtree_insert per key
+  test_insert_batch(1000, 50);
+  test_insert_batch(1000, 600);
+  test_insert_batch(20000, 3000);
+}
+
+#ifdef RBTREE_ORDER_STAT
+// every subtree size should equal the number of keys below it
+static size_t size_traverse(const node_t *p, const node_t *nil)
+{
+  if (p == nil)
+  {
+    return 0;
+  }
+  const size_t size = size_traverse(p->left, nil) + size_traverse(p->right, nil) + node_copies(p);
+  assert(p->size == size);
+  return size;
+}
+
+// select/rank/count_range should agree with the sorted keys
+void test_order_stat(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % (key_t)(n / 2 + 1);
+    nodes[i] = rbtree_insert(t, arr[i]);
+  }
+  // erase every third node and put the keys back in one batch
+  for (size_t i = 0; i < n; i += 3)
+  {
+    rbtree_erase(t, nodes[i]);
+  }
+  for (size_t i = 0; i < n; i += 3)
+  {
+    rbtree_insert_batch(t, &arr[i], 1);
+  }
+  assert(size_traverse(t->root, t->nil) == n);
+
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  for (size_t i = 0; i < n; i++)
+  {
+    node_t *p = rbtree_select(t, i);
+    assert(p != NULL && p->key == arr[i]);
+    size_t lt = 0;
+    while (lt < n && arr[lt] < arr[i])
+    {
+      lt++;
+    }
+    assert(rbtree_rank(t, arr[i]) == lt);
+  }
+  assert(rbtree_select(t, n) == NULL);
+  assert(rbtree_count_range(t, arr[0], arr[n - 1]) == n);
+  assert(rbtree_count_range(t, arr[n - 1], arr[0]) == (arr[0] == arr[n - 1] ? n : 0));
+  size_t in_range = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    in_range += arr[i] >= arr[n / 4] && arr[i] <= arr[n / 2];
+  }
+  assert(rbtree_count_range(t, arr[n / 4], arr[n / 2]) == in_range);
+
+  rbtree *u = rbtree_from_sorted_array(arr, n);
+  assert(size_traverse(u->root, u->nil) == n);
+  assert(rbtree_select(u, n / 2)->key == arr[n / 2]);
+
+  delete_rbtree(u);
+  free(nodes);
+  free(arr);
+  delete_rbtree(t);
+}
+#endif
+
+#ifdef RBTREE_AUGMENT
+// every subtree sum should equal the sum of the keys below it
+static long long sum_traverse(const node_t *p, const node_t *nil)
+{
+  if (p == nil)
+  {
+    return 0;
+  }
+  const long long sum = sum_traverse(p->left, nil) + sum_traverse(p->right, nil) + p->key;
+  assert(p->sum == sum);
+  return sum;
+}
+
+// augmentation hooks should keep the sample sum field up to date through every update
+void test_augment(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  long long total = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % 1000 - 500;
+    nodes[i] = rbtree_insert(t, arr[i]);
+    total += arr[i];
+  }
+  assert(sum_traverse(t->root, t->nil) == total);
+
+  for (size_t i = 0; i < n; i += 2)
+  {
+    rbtree_erase(t, nodes[i]);
+    total -= arr[i];
+  }
+  assert(sum_traverse(t->root, t->nil) == total);
+
+  rbtree_insert_batch(t, arr, n);
+  for (size_t i = 0; i < n; i++)
+  {
+    total += arr[i];
+  }
+  assert(sum_traverse(t->root, t->nil) == total);
+  assert(t->root->sum == total);
+  assert(t->nil->sum == 0);
+
+  free(nodes);
+  free(arr);
+  delete_rbtree(t);
+}
+#endif
+
+#ifdef RBTREE_INTERVAL
+typedef struct
+{
+  key_t lo, hi;
+  key_t last_start;
+  size_t seen;
+} overlap_ctx;
+
+// reference definition: two half-open ranges overlap when their intersection is non-empty
+static int ranges_intersect(const key_t a_lo, const key_t a_hi, const key_t b_lo, const key_t b_hi)
+{
+  const key_t from = a_lo > b_lo ? a_lo : b_lo;
+  const key_t to = a_hi < b_hi ? a_hi : b_hi;
+  return from < to;
+}
+
+static int check_overlap(node_t *p, void *arg)
+{
+  overlap_ctx *ctx = arg;
+  assert(ranges_intersect(p->key, p->end, ctx->lo, ctx->hi));
+  assert(ctx->seen == 0 || ctx->last_start <= p->key);
+  ctx->last_start = p->key;
+  ctx->seen++;
+  return 1;
+}
+
+static int stop_at_first(node_t *p, void *arg)
+{
+  return 0;
+}
+
+// overlap queries should match a linear scan
+void test_interval(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  node_t **nodes = calloc(n, sizeof(node_t *));
+  for (size_t i = 0; i < n; i++)
+  {
+    const key_t start = rand() % 10000;
+    nodes[i] = i % 5 == 0 ? rbtree_insert(t, start) : rbtree_interval_insert(t, start, start + rand() % 300);
+  }
+  for (size_t i = 0; i < n; i += 4)
+  {
+    rbtree_erase(t, nodes[i]);
+    nodes[i] = NULL;
+  }
+  test_color_constraint(t);
+
+  for (int q = 0; q < 200; q++)
+  {
+    const key_t lo = rand() % 10500 - 250;
+    const key_t hi = lo + rand() % 100 - 5;
+    size_t expect = 0;
+    node_t *first = NULL;
+    for (size_t i = 0; i < n; i++)
+    {
+      node_t *p = nodes[i];
+      if (p != NULL && ranges_intersect(p->key, p->end, lo, hi))
+      {
+        expect++;
+        if (first == NULL || p->key < first->key)
+        {
+          first = p;
+        }
+      }
+    }
+
+    overlap_ctx ctx = {lo, hi, 0, 0};
+    assert(rbtree_interval_overlap_all(t, lo, hi, check_overlap, &ctx) == expect);
+    assert(ctx.seen == expect);
+    assert(rbtree_interval_overlap_all(t, lo, hi, stop_at_first, NULL) == (expect > 0));
+
+    node_t *p = rbtree_interval_overlap_first(t, lo, hi);
+    if (first == NULL)
+    {
+      assert(p == NULL);
+    }
+    else
+    {
+      assert(p != NULL && p->key == first->key && ranges_intersect(p->key, p->end, lo, hi));
+    }
+  }
+
+  free(nodes);
+  delete_rbtree(t);
+}
+
+// empty intervals (plain keys) and empty queries overlap nothing, and must not steer the search
+void test_interval_empty(void)
+{
+  rbtree *t = new_rbtree();
+  rbtree_insert(t, 5);
+  assert(rbtree_interval_overlap_first(t, 3, 7) == NULL);
+  assert(rbtree_interval_overlap_all(t, 3, 7, stop_at_first, NULL) == 0);
+
+  node_t *wide = rbtree_interval_insert(t, 10, 20);
+  assert(rbtree_interval_overlap_first(t, 12, 12) == NULL);
+  assert(rbtree_interval_overlap_first(t, 15, 12) == NULL);
+  assert(rbtree_interval_overlap_all(t, 12, 12, stop_at_first, NULL) == 0);
+  assert(rbtree_interval_overlap_first(t, 12, 13) == wide);
+  rbtree_erase(t, wide);
+
+  // root [6,6) with [4,4) on the left and [8,12) on the right: the empty left subtree ends "after" 3,
+  // but the only overlap of [3,9) is on the right
+  rbtree_clear(t);
+  rbtree_insert(t, 6);
+  rbtree_insert(t, 4);
+  node_t *right = rbtree_interval_insert(t, 8, 12);
+  assert(t->root->key == 6 && t->root->left->key == 4 && t->root->right == right);
+  assert(rbtree_interval_overlap_first(t, 3, 9) == right);
+  overlap_ctx ctx = {3, 9, 0, 0};
+  assert(rbtree_interval_overlap_all(t, 3, 9, check_overlap, &ctx) == 1);
+
+  delete_rbtree(t);
+}
+#endif
+
+#ifdef RBTREE_MAP
+// upsert and get_or_insert should keep one node per key and read back the last value stored
+void test_map(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  const key_t range = (key_t)n / 2;
+  intptr_t *expect = calloc(range, sizeof(intptr_t));
+  size_t distinct = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    const key_t k = rand() % range;
+    distinct += expect[k] == 0;
+    expect[k] = (intptr_t)i + 1;
+    node_t *p = rbtree_upsert(t, k, (value_t)expect[k]);
+    assert(p != NULL && p->key == k && (intptr_t)p->value == expect[k]);
+  }
+  assert(t->count == distinct);
+  test_color_constraint(t);
+
+  for (key_t k = 0; k < range; k++)
+  {
+    int inserted = -1;
+    node_t *p = rbtree_get_or_insert(t, k, &inserted);
+    assert(p != NULL && p->key == k);
+    assert(inserted == (expect[k] == 0));
+    assert((intptr_t)p->value == expect[k]);
+    assert(p == rbtree_get_or_insert(t, k, NULL));
+    p->value = (value_t)(intptr_t)-k;
+  }
+  assert(t->count == (size_t)range);
+  test_color_constraint(t);
+
+  // erased nodes are recycled: a new key must not inherit the old payload
+  rbtree_erase(t, rbtree_find(t, 0));
+  int inserted = 0;
+  node_t *p = rbtree_get_or_insert(t, range, &inserted);
+  assert(inserted && p->value == 0);
+  for (key_t k = 1; k <= range; k++)
+  {
+    assert((intptr_t)rbtree_find(t, k)->value == (k < range ? -k : 0));
+  }
+
+  free(expect);
+  delete_rbtree(t);
+}
+#endif
+
+#ifdef RBTREE_COUNTED
+static size_t count_nodes(const node_t *p, const node_t *nil)
+{
+  return p == nil ? 0 : count_nodes(p->left, nil) + count_nodes(p->right, nil) + 1;
+}
+
+// heavily duplicated keys should share one node per key and still expand in order
+void test_counted(const size_t copies)
+{
+  const key_t keys[] = {7, -3, 12, 7, 0};
+  const size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+  rbtree *t = new_rbtree();
+  node_t *first[5];
+  for (size_t c = 0; c < copies; c++)
+  {
+    for (size_t i = 0; i < nkeys; i++)
+    {
+      node_t *p = rbtree_insert(t, keys[i]);
+      if (c == 0 && (i == 0 || keys[i] != keys[0]))
+      {
+        first[i] = p;
+      }
+      assert(p == (keys[i] == 7 ? first[0] : first[i]));
+    }
+  }
+  assert(t->count == copies * nkeys);
+  assert(count_nodes(t->root, t->nil) == 4);
+  assert(rbtree_find(t, 7)->dup == 2 * copies);
+
+  key_t *arr = calloc(copies * nkeys, sizeof(key_t));
+  assert(rbtree_to_array(t, arr, copies * nkeys) == (int)(copies * nkeys));
+  for (size_t i = 1; i < copies * nkeys; i++)
+  {
+    assert(arr[i - 1] <= arr[i]);
+  }
+  assert(arr[0] == -3 && arr[copies] == 0 && arr[2 * copies] == 7 && arr[4 * copies] == 12);
+  assert(rbtree_range_to_array(t, 0, 7, arr, 3 * copies + 1) == 3 * copies);
+#ifdef RBTREE_ORDER_STAT
+  assert(rbtree_select(t, 2 * copies)->key == 7 && rbtree_rank(t, 12) == 4 * copies);
+#endif
+
+  // erase drops one copy at a time; the node goes with the last one
+  for (size_t c = 0; c < copies; c++)
+  {
+    assert(rbtree_erase(t, rbtree_find(t, -3)));
+  }
+  assert(rbtree_find(t, -3) == NULL && count_nodes(t->root, t->nil) == 3);
+  assert(t->count == (nkeys - 1) * copies);
+
+  // batches and sorted builds merge equal keys too
+  rbtree_insert_batch(t, arr, 3 * copies);
+  assert(count_nodes(t->root, t->nil) == 3 && rbtree_find(t, 0)->dup == 2 * copies);
+  rbtree *u = rbtree_from_sorted_array(arr, 3 * copies);
+  assert(count_nodes(u->root, u->nil) == 2 && u->count == 3 * copies);
+  assert(rbtree_find(u, 7)->dup == 2 * copies);
+#ifdef RBTREE_ORDER_STAT
+  assert(size_traverse(u->root, u->nil) == 3 * copies);
+#endif
+  test_color_constraint(t);
+  test_color_constraint(u);
+
+  free(arr);
+  delete_rbtree(u);
+  delete_rbtree(t);
+}
+#endif
+
+// hinted and near-sorted inserts should land in the same order a full descent gives
+void test_insert_hint(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(3 * n, sizeof(key_t));
+  size_t m = 0;
+  // mostly ascending with repeats and stragglers: the automatic hint takes most of these
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[m] = (key_t)i - (rand() % 8 == 0 ? rand() % 50 : 0);
+    assert(rbtree_insert(t, arr[m])->key == arr[m]);
+    m++;
+  }
+  // descending run, each key hinted at the node inserted before it
+  node_t *hint = rbtree_max(t);
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[m] = (key_t)(2 * n - i);
+    hint = rbtree_insert_hint(t, arr[m], hint);
+    assert(hint != NULL && hint->key == arr[m]);
+    m++;
+  }
+  // random keys with random (often wrong) hints, and hints next to erased nodes
+  for (size_t i = 0; i < n; i++)
+  {
+    node_t *h = rbtree_lower_bound(t, rand() % (key_t)(2 * n));
+    arr[m] = rand() % (key_t)(2 * n);
+    node_t *p = rbtree_insert_hint(t, arr[m], h);
+    assert(p != NULL && p->key == arr[m]);
+    if (i % 7 != 0)
+    {
+      m++;
+    }
+    else
+    {
+      assert(rbtree_erase(t, p)); // the hint (or its neighbour) goes away again
+    }
+  }
+  assert(rbtree_insert_hint(t, -1, NULL)->key == -1);
+  arr[m++] = -1;
+  assert(t->count == m);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  key_t *res = calloc(m, sizeof(key_t));
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  assert(rbtree_to_array(t, res, m) == (int)m);
+  for (size_t i = 0; i < m; i++)
+  {
+    assert(res[i] == arr[i]);
+  }
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// walks the spines the way rbtree_min/rbtree_max used to, to check the cached extremes
+static void check_extremes(const rbtree *t)
+{
+  node_t *lo = t->root, *hi = t->root;
+  while (lo != t->nil && lo->left != t->nil)
+  {
+    lo = lo->left;
+  }
+  while (hi != t->nil && hi->right != t->nil)
+  {
+    hi = hi->right;
+  }
+  assert(rbtree_min(t) == lo);
+  assert(rbtree_max(t) == hi);
+}
+
+void test_pop_minmax(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t key;
+  assert(rbtree_pop_min(t, &key) == 0);
+  assert(rbtree_pop_max(t, NULL) == 0);
+  check_extremes(t);
+
+  // random inserts and erases anywhere in the tree
+  key_t *arr = calloc(2 * n, sizeof(key_t));
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[m] = rand() % (key_t)n - (key_t)(n / 2);
+    rbtree_insert(t, arr[m++]);
+    check_extremes(t);
+    if (i % 5 == 4)
+    {
+      node_t *p = rbtree_find(t, arr[m - 1 - rand() % 5]);
+      assert(p != NULL);
+      for (size_t j = 0; j < m; j++) // drop that key from the reference too
+      {
+        if (arr[j] == p->key)
+        {
+          arr[j] = arr[--m];
+          break;
+        }
+      }
+      rbtree_erase(t, p);
+      check_extremes(t);
+    }
+  }
+  // a batch large enough to rebuild, reaching past both ends
+  key_t batch[64];
+  for (size_t i = 0; i < 64; i++)
+  {
+    batch[i] = arr[m++] = (key_t)(i % 2 == 0 ? n + i : -(key_t)n - (key_t)i);
+  }
+  assert(rbtree_insert_batch(t, batch, 64) == 64);
+  check_extremes(t);
+  assert(t->count == m);
+
+  // drain from both ends: keys come out in sorted order
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  size_t lo = 0, hi = m;
+  while (lo < hi)
+  {
+    if (rand() % 2 == 0)
+    {
+      assert(rbtree_pop_min(t, &key) == 1);
+      assert(key == arr[lo++]);
+    }
+    else
+    {
+      assert(rbtree_pop_max(t, &key) == 1);
+      assert(key == arr[--hi]);
+    }
+    check_extremes(t);
+    if (lo % 97 == 0)
+    {
+      test_color_constraint(t);
+    }
+  }
+  assert(t->count == 0 && t->root == t->nil);
+  assert(rbtree_pop_min(t, &key) == 0);
+  free(arr);
+  delete_rbtree(t);
+
+  t = rbtree_from_sorted_array((const key_t[]){1, 2, 3, 5, 8}, 5);
+  check_extremes(t);
+  assert(rbtree_min(t)->key == 1 && rbtree_max(t)->key == 8);
+  rbtree_clear(t);
+  check_extremes(t);
+  rbtree_insert(t, 7);
+  assert(rbtree_min(t) == rbtree_max(t) && rbtree_min(t)->key == 7);
+  assert(rbtree_pop_max(t, &key) == 1 && key == 7);
+  check_extremes(t);
+  delete_rbtree(t);
+}
+
+typedef struct
+{
+  int id;
+  node_t link;
+} intrusive_obj;
+
+// caller-owned nodes should link and unlink without the tree allocating or freeing them
+void test_intrusive(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  intrusive_obj *objs = calloc(n, sizeof(intrusive_obj));
+  key_t *keys = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    objs[i].id = (int)i;
+    objs[i].link.key = keys[i] = rand() % (key_t)n;
+#ifdef RBTREE_INTERVAL
+    objs[i].link.end = objs[i].link.key;
+#endif
+    assert(rbtree_insert_node(t, &objs[i].link) == &objs[i].link);
+  }
+  rbtree_insert(t, (key_t)n); // slab nodes can share the tree
+  assert(t->count == n + 1);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    node_t *p = rbtree_find(t, keys[i]);
+    assert(p != NULL && p->key == keys[i]);
+    intrusive_obj *o = rbtree_entry(p, intrusive_obj, link);
+    assert(o >= objs && o < objs + n && keys[o->id] == keys[i]);
+  }
+
+  for (size_t i = 0; i < n; i += 2)
+  {
+    assert(rbtree_remove_node(t, &objs[i].link));
+  }
+  assert(t->count == n / 2 + 1);
+  test_color_constraint(t);
+  test_search_constraint(t);
+  for (size_t i = 1; i < n; i += 2)
+  {
+    rbtree_remove_node(t, &objs[i].link);
+  }
+  assert(t->count == 1 && t->root->key == (key_t)n);
+
+  // a removed node can be linked again, here into a second tree
+  rbtree *u = new_rbtree();
+  rbtree_insert_node(u, &objs[0].link);
+  assert(rbtree_min(u) == &objs[0].link);
+  rbtree_remove_node(u, &objs[0].link);
+
+  free(keys);
+  free(objs); // the trees never owned these
+  delete_rbtree(u);
+  delete_rbtree(t);
+}
+
+// bounds and cursor steps should walk the keys in sorted order
+void test_bounds_cursor(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % (key_t)(n / 2 + 1) * 2; // even keys with duplicates
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  // forward and backward over the whole tree
+  size_t i = 0;
+  for (node_t *p = rbtree_lower_bound(t, arr[0]); p != NULL; p = rbtree_next(t, p))
+  {
+    assert(i < n && p->key == arr[i]);
+    i += node_copies(p);
+    assert(i <= n && p->key == arr[i - 1]);
+  }
+  assert(i == n);
+  for (node_t *p = rbtree_max(t); p != NULL; p = rbtree_prev(t, p))
+  {
+    assert(i >= node_copies(p) && p->key == arr[i - 1]);
+    i -= node_copies(p);
+    assert(p->key == arr[i]);
+  }
+  assert(i == 0);
+
+  for (key_t key = arr[0] - 1; key <= arr[n - 1] + 1; key++)
+  {
+    size_t lb = 0, ub = 0;
+    while (lb < n && arr[lb] < key)
+    {
+      lb++;
+    }
+    ub = lb;
+    while (ub < n && arr[ub] <= key)
+    {
+      ub++;
+    }
+    node_t *p = rbtree_lower_bound(t, key);
+    node_t *q = rbtree_upper_bound(t, key);
+    assert(lb == n ? p == NULL : p != NULL && p->key == arr[lb]);
+    assert(ub == n ? q == NULL : q != NULL && q->key == arr[ub]);
+    // lower_bound lands on the first of the duplicates
+    assert(p == NULL || rbtree_prev(t, p) == NULL || rbtree_prev(t, p)->key < key);
+  }
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+// range export should copy exactly the keys in [lo, hi], bounded by capacity
+void test_range_to_array(const size_t n)
+{
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    arr[i] = rand() % (key_t)n;
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  assert(rbtree_to_array(t, res, n + 1) == (int)n);
+  assert(rbtree_to_array(t, res, n / 2) == (int)(n / 2));
+
+  for (int q = 0; q < 100; q++)
+  {
+    const key_t lo = rand() % (key_t)n - 5;
+    const key_t hi = lo + rand() % 50;
+    const size_t cap = q % 2 ? n : 7;
+    size_t first = 0, count = 0;
+    while (first < n && arr[first] < lo)
+    {
+      first++;
+    }
+    while (first + count < n && arr[first + count] <= hi)
+    {
+      count++;
+    }
+    const size_t expect = count < cap ? count : cap;
+    assert(rbtree_range_to_array(t, lo, hi, res, cap) == expect);
+    for (size_t i = 0; i < expect; i++)
+    {
+      assert(res[i] == arr[first + i]);
+    }
+  }
+  assert(rbtree_range_to_array(t, 10, 5, res, n) == 0);
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+#ifdef RBTREE_COMPACT
+// compact nodes should be aligned (32 bytes when not augmented) and keep color and parent apart in one word
+void test_compact_layout(void)
+{
+  const uintptr_t align = _Alignof(node_t) - 1;
+  assert(sizeof(node_t) % _Alignof(node_t) == 0);
+#if !defined(RBTREE_ORDER_STAT) && !defined(RBTREE_INTERVAL) && !defined(RBTREE_AUGMENT_FIELDS) && !defined(RBTREE_MAP) && \
+    !defined(RBTREE_COUNTED)
+  assert(sizeof(node_t) == 32 && _Alignof(node_t) == 32);
+#endif
+  rbtree *t = new_rbtree();
+  for (key_t k = 0; k < 100; k++)
+  {
+    node_t *p = rbtree_insert(t, k);
+    assert(((uintptr_t)p & align) == 0);
+  }
+  assert(((uintptr_t)t->nil & align) == 0);
+  for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p))
+  {
+    const color_t c = rbtree_color(p);
+    node_t *parent = rbtree_parent(p);
+    rbtree_set_color(p, c == RBTREE_RED ? RBTREE_BLACK : RBTREE_RED);
+    assert(rbtree_parent(p) == parent);
+    rbtree_set_color(p, c);
+    rbtree_set_parent(p, parent);
+    assert(rbtree_color(p) == c);
+  }
+  test_color_constraint(t);
+  delete_rbtree(t);
+}
+#endif
+
 int main(void)
 {
   test_init();
@@ -426,5 +1306,35 @@ int main(void)
   test_duplicate_values();
   test_multi_instance();
   test_find_erase_rand(10000, 17);
+  test_capacity();
+  test_clear();
+  test_from_sorted_array_suite();
+  test_insert_batch_suite();
+  test_intrusive(1000);
+  test_insert_hint(2000);
+  test_pop_minmax(3000);
+  test_bounds_cursor(1);
+  test_bounds_cursor(1000);
+  test_range_to_array(1000);
+#ifdef RBTREE_ORDER_STAT
+  test_order_stat(1);
+  test_order_stat(1000);
+#endif
+#ifdef RBTREE_AUGMENT
+  test_augment(2000);
+#endif
+#ifdef RBTREE_INTERVAL
+  test_interval(3000);
+  test_interval_empty();
+#endif
+#ifdef RBTREE_COMPACT
+  test_compact_layout();
+#endif
+#ifdef RBTREE_MAP
+  test_map(5000);
+#endif
+#ifdef RBTREE_COUNTED
+  test_counted(10000);
+#endif
   printf("Passed all tests!\n");
 }
\ No newline at end of file
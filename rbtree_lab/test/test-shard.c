@@ -0,0 +1,200 @@
+#include <assert.h>
+#include "rbtree_shard.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PARTS 4
+#define THREADS 4
+#define PER_THREAD 5000
+
+static rbtree_shard *shared;
+
+// every part of the container, and the container as a whole, should hold keys in order
+static void check_layout(rbtree_shard *s, const size_t expected)
+{
+  key_t *res = calloc(expected + 1, sizeof(key_t));
+  assert(rbtree_shard_to_array(s, res, expected + 1) == (int)expected);
+  for (size_t i = 1; i < expected; i++)
+  {
+    assert(res[i - 1] <= res[i]);
+  }
+  for (size_t i = 0; i < s->nparts; i++)
+  {
+    const rbtree *t = s->parts[i].tree;
+    if (t->root == t->nil)
+    {
+      continue;
+    }
+    if (i > 0)
+    {
+      assert(rbtree_min(t)->key >= s->bounds[i - 1]);
+    }
+    if (i + 1 < s->nparts)
+    {
+      assert(rbtree_max(t)->key < s->bounds[i]);
+    }
+  }
+  free(res);
+}
+
+// empty container should report no keys
+void test_empty(void)
+{
+  rbtree_shard *s = new_rbtree_shard(PARTS, 0, 1000);
+  key_t k;
+  assert(!rbtree_shard_min(s, &k));
+  assert(!rbtree_shard_max(s, &k));
+  assert(!rbtree_shard_find(s, 1));
+  assert(!rbtree_shard_erase(s, 1));
+  assert(rbtree_shard_to_array(s, &k, 1) == 0);
+  rbtree_shard_rebalance(s);
+  delete_rbtree_shard(s);
+}
+
+// keys outside the initial range and duplicates go to the edge parts and keep their order
+void test_single_thread(void)
+{
+  rbtree_shard *s = new_rbtree_shard(PARTS, 0, 100);
+  const key_t keys[] = {50, -10, 99, 250, 0, 25, 25, 75, 1000, -1000};
+  const size_t n = sizeof(keys) / sizeof(keys[0]);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(rbtree_shard_insert(s, keys[i]));
+  }
+  check_layout(s, n);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(rbtree_shard_find(s, keys[i]));
+  }
+  assert(!rbtree_shard_find(s, 26));
+  key_t lo, hi;
+  assert(rbtree_shard_min(s, &lo) && lo == -1000);
+  assert(rbtree_shard_max(s, &hi) && hi == 1000);
+
+  rbtree_shard_rebalance(s);
+  check_layout(s, n);
+  assert(rbtree_shard_erase(s, 25));
+  assert(rbtree_shard_find(s, 25));
+  assert(rbtree_shard_erase(s, 25));
+  assert(!rbtree_shard_find(s, 25));
+  assert(rbtree_shard_erase(s, -1000) && rbtree_shard_erase(s, 1000));
+  assert(rbtree_shard_min(s, &lo) && lo == -10);
+  assert(rbtree_shard_max(s, &hi) && hi == 250);
+  check_layout(s, n - 4);
+  delete_rbtree_shard(s);
+}
+
+// keys piling into one part should move the bounds on their own
+void test_skew_rebalance(void)
+{
+  rbtree_shard *s = new_rbtree_shard(PARTS, 0, 1 << 20);
+  const size_t n = 20000;
+  for (key_t k = 0; k < (key_t)n; k++)
+  {
+    assert(rbtree_shard_insert(s, k)); // all below the first initial bound
+  }
+  check_layout(s, n);
+  for (size_t i = 0; i < s->nparts; i++)
+  {
+    assert(s->parts[i].tree->count <= s->rebalance_limit);
+    assert(s->parts[i].tree->count > 0);
+  }
+  for (key_t k = 0; k < (key_t)n; k++)
+  {
+    assert(rbtree_shard_find(s, k));
+  }
+
+  // a single repeated key cannot be split, but must not rebalance on every insert either
+  rbtree_shard *dup = new_rbtree_shard(PARTS, 0, 100);
+  for (size_t i = 0; i < n; i++)
+  {
+    assert(rbtree_shard_insert(dup, 7));
+  }
+  check_layout(dup, n);
+  assert(dup->version < 16);
+  delete_rbtree_shard(dup);
+  delete_rbtree_shard(s);
+}
+
+// writers insert disjoint ranges and erase every other key again
+static void *writer(void *arg)
+{
+  const key_t base = (key_t)(size_t)arg * PER_THREAD;
+  for (key_t i = 0; i < PER_THREAD; i++)
+  {
+    assert(rbtree_shard_insert(shared, base + i));
+  }
+  for (key_t i = 0; i < PER_THREAD; i += 2)
+  {
+    assert(rbtree_shard_erase(shared, base + i));
+  }
+  return NULL;
+}
+
+// readers run concurrently and must always see an ordered container
+static void *reader(void *arg)
+{
+  key_t *buf = calloc(THREADS * PER_THREAD, sizeof(key_t));
+  for (int round = 0; round < 50; round++)
+  {
+    const int n = rbtree_shard_to_array(shared, buf, THREADS * PER_THREAD);
+    for (int i = 1; i < n; i++)
+    {
+      assert(buf[i - 1] < buf[i]);
+    }
+    key_t lo, hi;
+    if (rbtree_shard_min(shared, &lo) && rbtree_shard_max(shared, &hi))
+    {
+      assert(lo <= hi);
+    }
+    if (round % 10 == 0)
+    {
+      rbtree_shard_rebalance(shared);
+    }
+  }
+  free(buf);
+  return NULL;
+}
+
+// concurrent writers, readers and rebalances should leave exactly the odd keys behind
+void test_concurrent(void)
+{
+  shared = new_rbtree_shard(PARTS, 0, THREADS * PER_THREAD);
+  assert(shared != NULL);
+
+  pthread_t threads[2 * THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+  {
+    pthread_create(&threads[i], NULL, writer, (void *)i);
+    pthread_create(&threads[THREADS + i], NULL, reader, NULL);
+  }
+  for (size_t i = 0; i < 2 * THREADS; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  key_t *res = calloc(THREADS * PER_THREAD, sizeof(key_t));
+  assert(rbtree_shard_to_array(shared, res, THREADS * PER_THREAD) == THREADS * PER_THREAD / 2);
+  for (int i = 0; i < THREADS * PER_THREAD / 2; i++)
+  {
+    assert(res[i] == 2 * i + 1);
+  }
+  for (key_t k = 0; k < THREADS * PER_THREAD; k++)
+  {
+    assert(rbtree_shard_find(shared, k) == (k % 2 == 1));
+  }
+  check_layout(shared, THREADS * PER_THREAD / 2);
+
+  free(res);
+  delete_rbtree_shard(shared);
+}
+
+int main(void)
+{
+  test_empty();
+  test_single_thread();
+  test_skew_rebalance();
+  test_concurrent();
+  printf("Passed all tests!\n");
+}
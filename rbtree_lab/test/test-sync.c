@@ -0,0 +1,171 @@
+#include <assert.h>
+#include "rbtree_sync.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THREADS 4
+#define PER_THREAD 2000
+
+static rbtree_sync *shared;
+
+// writers insert disjoint ranges and erase every other key again
+static void *writer(void *arg)
+{
+  const key_t base = (key_t)(size_t)arg * PER_THREAD;
+  for (key_t i = 0; i < PER_THREAD; i++)
+  {
+    assert(rbtree_sync_insert(shared, base + i));
+  }
+  for (key_t i = 0; i < PER_THREAD; i += 2)
+  {
+    assert(rbtree_sync_erase(shared, base + i));
+  }
+  return NULL;
+}
+
+// readers run concurrently and must always see an ordered tree
+static void *reader(void *arg)
+{
+  key_t *buf = calloc(THREADS * PER_THREAD, sizeof(key_t));
+  for (int round = 0; round < 50; round++)
+  {
+    const int n = rbtree_sync_to_array(shared, buf, THREADS * PER_THREAD);
+    for (int i = 1; i < n; i++)
+    {
+      assert(buf[i - 1] <= buf[i]);
+    }
+    key_t lo, hi;
+    if (rbtree_sync_min(shared, &lo) && rbtree_sync_max(shared, &hi))
+    {
+      assert(lo <= hi);
+    }
+    rbtree_sync_find(shared, round);
+  }
+  free(buf);
+  return NULL;
+}
+
+// concurrent writers and readers should leave exactly the odd keys behind
+void test_concurrent(void)
+{
+  shared = new_rbtree_sync();
+  assert(shared != NULL);
+
+  pthread_t threads[2 * THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+  {
+    pthread_create(&threads[i], NULL, writer, (void *)i);
+    pthread_create(&threads[THREADS + i], NULL, reader, NULL);
+  }
+  for (size_t i = 0; i < 2 * THREADS; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  key_t *res = calloc(THREADS * PER_THREAD, sizeof(key_t));
+  assert(rbtree_sync_to_array(shared, res, THREADS * PER_THREAD) == THREADS * PER_THREAD / 2);
+  for (int i = 0; i < THREADS * PER_THREAD / 2; i++)
+  {
+    assert(res[i] == 2 * i + 1);
+  }
+  for (key_t k = 0; k < THREADS * PER_THREAD; k++)
+  {
+    assert(rbtree_sync_find(shared, k) == (k % 2 == 1));
+  }
+  key_t lo, hi;
+  assert(rbtree_sync_min(shared, &lo) && lo == 1);
+  assert(rbtree_sync_max(shared, &hi) && hi == THREADS * PER_THREAD - 1);
+  assert(!rbtree_sync_erase(shared, 0));
+
+  free(res);
+  delete_rbtree_sync(shared);
+}
+
+// empty wrapper should report no keys
+void test_empty(void)
+{
+  rbtree_sync *s = new_rbtree_sync();
+  key_t k;
+  assert(!rbtree_sync_min(s, &k));
+  assert(!rbtree_sync_max(s, &k));
+  assert(!rbtree_sync_find(s, 1));
+  assert(rbtree_sync_to_array(s, &k, 1) == 0);
+  delete_rbtree_sync(s);
+}
+
+#define STABLE 500
+
+static volatile int churning;
+
+// writers keep inserting and erasing keys next to the stable ones
+static void *churner(void *arg)
+{
+  const key_t offset = (key_t)(size_t)arg + 1;
+  for (int round = 0; round < 200; round++)
+  {
+    for (key_t k = 0; k < STABLE; k += 7)
+    {
+      rbtree_sync_insert(shared, k * 10 + offset);
+    }
+    for (key_t k = 0; k < STABLE; k += 7)
+    {
+      rbtree_sync_erase(shared, k * 10 + offset);
+    }
+  }
+  return NULL;
+}
+
+// lock-free readers must keep seeing every stable key while writers rotate around them
+static void *stable_reader(void *arg)
+{
+  while (churning)
+  {
+    for (key_t k = 0; k < STABLE; k++)
+    {
+      assert(rbtree_sync_find(shared, k * 10));
+    }
+    key_t lo, hi;
+    assert(rbtree_sync_min(shared, &lo) && lo == 0);
+    assert(rbtree_sync_max(shared, &hi) && hi == (STABLE - 1) * 10 + THREADS);
+  }
+  return NULL;
+}
+
+void test_readers_during_writes(void)
+{
+  shared = new_rbtree_sync();
+  for (key_t k = 0; k < STABLE; k++)
+  {
+    rbtree_sync_insert(shared, k * 10);
+  }
+  rbtree_sync_insert(shared, (STABLE - 1) * 10 + THREADS); // stable maximum above every churned key
+
+  pthread_t writers[THREADS], readers[THREADS];
+  churning = 1;
+  for (size_t i = 0; i < THREADS; i++)
+  {
+    pthread_create(&readers[i], NULL, stable_reader, NULL);
+    pthread_create(&writers[i], NULL, churner, (void *)i);
+  }
+  for (size_t i = 0; i < THREADS; i++)
+  {
+    pthread_join(writers[i], NULL);
+  }
+  churning = 0;
+  for (size_t i = 0; i < THREADS; i++)
+  {
+    pthread_join(readers[i], NULL);
+  }
+
+  assert(rbtree_sync_to_array(shared, (key_t[STABLE + 1]){0}, STABLE + 1) == STABLE + 1);
+  delete_rbtree_sync(shared);
+}
+
+int main(void)
+{
+  test_empty();
+  test_concurrent();
+  test_readers_during_writes();
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,193 @@
+#include <assert.h>
+#include "rbtree_topdown.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Checks red-black invariants the way the engine sees them: NULL children are black, equal keys
+// may sit on either side of a node (insert sends them right, rotations can move them left).
+// Returns the black height and stores the height in *height.
+static int check_td(const tdnode_t *n, int *height)
+{
+  if (n == NULL)
+  {
+    *height = 0;
+    return 1;
+  }
+  if (n->color == RBTREE_RED)
+  {
+    assert(n->link[0] == NULL || n->link[0]->color == RBTREE_BLACK);
+    assert(n->link[1] == NULL || n->link[1]->color == RBTREE_BLACK);
+  }
+  assert(n->link[0] == NULL || n->link[0]->key <= n->key);
+  assert(n->link[1] == NULL || n->link[1]->key >= n->key);
+  int left, right;
+  const int black = check_td(n->link[0], &left);
+  assert(black == check_td(n->link[1], &right));
+  *height = 1 + (left > right ? left : right);
+  return black + (n->color == RBTREE_BLACK);
+}
+
+// Height of a valid tree; the root must be black.
+static int td_height(const rbtree_td *t)
+{
+  int height;
+  assert(t->root == NULL || t->root->color == RBTREE_BLACK);
+  check_td(t->root, &height);
+  return height;
+}
+
+// Nodes in key order, so a test can tell which node a key moved out of.
+static void collect(const tdnode_t *n, const tdnode_t **out, size_t *i)
+{
+  if (n == NULL)
+  {
+    return;
+  }
+  collect(n->link[0], out, i);
+  out[(*i)++] = n;
+  collect(n->link[1], out, i);
+}
+
+// Erasing a key held by an inner node unlinks the leaf next to it in the same pass and moves the
+// leaf's key up: the node keeps its address, and the erased key's predecessor now lives there.
+void test_erase_inner(const size_t n)
+{
+  rbtree_td *t = new_rbtree_td();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_td_insert(t, (key_t)i);
+  }
+  const tdnode_t **before = calloc(n, sizeof(tdnode_t *));
+  const tdnode_t **after = calloc(n, sizeof(tdnode_t *));
+  for (size_t round = 0; round < n / 2; round++)
+  {
+    tdnode_t *inner = t->root; // two children: count stays n
+    assert(inner->link[0] != NULL && inner->link[1] != NULL);
+    const key_t key = inner->key;
+    size_t nb = 0, na = 0, at = 0;
+    collect(t->root, before, &nb);
+    while (before[at] != inner)
+    {
+      at++;
+    }
+    const tdnode_t *leaf = before[at - 1]; // the predecessor ends the erase path
+    const key_t pred = leaf->key;
+
+    assert(rbtree_td_erase(t, key));
+    assert(rbtree_td_find(t, key) == NULL);
+    assert(inner->key == pred);
+    assert(rbtree_td_find(t, pred) == inner);
+    td_height(t);
+
+    // every node but the leaf is still linked, in the same order
+    collect(t->root, after, &na);
+    assert(na == nb - 1);
+    for (size_t i = 0, j = 0; i < nb; i++)
+    {
+      if (before[i] != leaf)
+      {
+        assert(after[j++] == before[i]);
+      }
+    }
+    // and the leaf is the next node handed out
+    assert(rbtree_td_insert(t, (key_t)(n + round)) == leaf);
+  }
+  assert(t->count == n);
+  free(after);
+  free(before);
+  delete_rbtree_td(t);
+}
+
+// Erase walks left on equal keys, so it always takes the first copy in key order (its lower
+// bound) and every later copy keeps its node; a right-leaning walk would take the last one.
+void test_equal_keys_left(const size_t copies)
+{
+  rbtree_td *t = new_rbtree_td();
+  const key_t dup = 50;
+  for (key_t k = 0; k < 100; k++)
+  {
+    rbtree_td_insert(t, k);
+  }
+  for (size_t i = 1; i < copies; i++)
+  {
+    rbtree_td_insert(t, dup);
+  }
+  const tdnode_t **before = calloc(t->count, sizeof(tdnode_t *));
+  const tdnode_t **after = calloc(t->count, sizeof(tdnode_t *));
+  for (size_t left = copies; left > 0; left--)
+  {
+    size_t nb = 0, na = 0;
+    collect(t->root, before, &nb);
+    size_t first = 0;
+    while (before[first]->key < dup)
+    {
+      first++;
+    }
+    assert(rbtree_td_lower_bound(t, dup) == before[first]);
+
+    assert(rbtree_td_erase(t, dup));
+    td_height(t);
+    collect(t->root, after, &na);
+    assert(na == nb - 1);
+    size_t kept = 0;
+    for (size_t i = 0; i < na; i++)
+    {
+      if (after[i]->key == dup)
+      {
+        assert(after[i] == before[first + 1 + kept]); // later copies, same nodes, same order
+        kept++;
+      }
+    }
+    assert(kept == left - 1);
+  }
+  assert(rbtree_td_find(t, dup) == NULL);
+  assert(!rbtree_td_erase(t, dup));
+  assert(t->count == 99);
+  free(after);
+  free(before);
+  delete_rbtree_td(t);
+}
+
+// to_array keeps its path in a TD_MAX_DEPTH (128) stack, enough for any size_t count as long as
+// the height stays within 2 * log2(count + 1). Sorted runs rotate the most at the top, and erasing
+// every other key leaves the sparse shape erase has to rebalance.
+void test_depth_bound(const size_t n)
+{
+  rbtree_td *t = new_rbtree_td();
+  for (size_t i = 0; i < n; i++)
+  {
+    rbtree_td_insert(t, (key_t)i);
+    rbtree_td_insert(t, -(key_t)i - 1);
+  }
+  int bits = 0;
+  while (((size_t)1 << bits) <= t->count)
+  {
+    bits++;
+  }
+  assert(td_height(t) <= 2 * bits);
+  for (size_t i = 0; i < n; i += 2)
+  {
+    assert(rbtree_td_erase(t, (key_t)i));
+    assert(rbtree_td_erase(t, -(key_t)i - 1));
+  }
+  assert(td_height(t) <= 2 * bits);
+
+  key_t *arr = calloc(t->count, sizeof(key_t));
+  assert(rbtree_td_to_array(t, arr, t->count) == (int)t->count);
+  for (size_t i = 1; i < t->count; i++)
+  {
+    assert(arr[i - 1] < arr[i]);
+  }
+  assert(arr[0] == rbtree_td_min(t)->key && arr[t->count - 1] == rbtree_td_max(t)->key);
+  free(arr);
+  delete_rbtree_td(t);
+}
+
+int main(void)
+{
+  test_erase_inner(1000);
+  test_equal_keys_left(1);
+  test_equal_keys_left(64);
+  test_depth_bound(1 << 18);
+  printf("Passed all tests!\n");
+}